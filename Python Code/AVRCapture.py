@@ -0,0 +1,86 @@
+############################################
+#
+# AVRCapture.py
+#
+# Records everything read from and written to the AVR, so a session can be
+# replayed later with AVRReplay.py.
+#
+# A capture is MAGIC followed by records of
+#   microseconds since the previous record (uint32), direction (uint8),
+#   payload length (uint16), payload
+# all big-endian. The timestamp is taken when the bytes were read or written.
+#
+############################################
+
+import struct, time
+
+MAGIC = 'AVRCAP1\n'
+RECORD = struct.Struct('>IBH')
+
+FROM_AVR = 0
+TO_AVR = 1
+
+class CaptureTransport(object):
+	#passes everything through to another transport, logging it on the way.
+	#reads and writes both happen on the serial thread once it has started
+	def __init__(self, transport, path):
+		self.transport = transport
+		self.log = open(path, 'wb')
+		self.log.write(MAGIC)
+		self.start = time.time()
+		self.last = 0						#microseconds from start to the previous record
+
+	def read(self, size=1):
+		data = self.transport.read(size)
+		self.record(FROM_AVR, data)
+		return data
+
+	def inWaiting(self):
+		return self.transport.inWaiting()
+
+	def flush(self):
+		self.transport.flush()
+
+	@property
+	def baudrate(self):
+		return self.transport.baudrate
+
+	@baudrate.setter
+	def baudrate(self, rate):
+		self.transport.baudrate = rate
+
+	def write(self, data):
+		self.transport.write(data)
+		self.record(TO_AVR, data)
+
+	def record(self, direction, data):
+		if not data:
+			return
+		stamp = int((time.time() - self.start) * 1000000)
+		delta, self.last = stamp - self.last, stamp
+		for i in range(0, len(data), 0xFFFF):
+			chunk = data[i:i + 0xFFFF]
+			self.log.write(RECORD.pack(min(delta, 0xFFFFFFFF), direction, len(chunk)))
+			self.log.write(chunk)
+			delta = 0
+		#a crash should not lose the frames leading up to it
+		self.log.flush()
+
+def readCapture(path):
+	#yields (seconds since the capture started, direction, payload) for each record
+	log = open(path, 'rb')
+	if log.read(len(MAGIC)) != MAGIC:
+		raise ValueError("%s is not a capture" % path)
+
+	stamp = 0
+	while True:
+		header = log.read(RECORD.size)
+		if len(header) < RECORD.size:
+			return
+		delta, direction, length = RECORD.unpack(header)
+		data = log.read(length)
+		if len(data) < length:
+			#cut short while it was being written
+			return
+		stamp += delta
+		yield stamp / 1000000.0, direction, data
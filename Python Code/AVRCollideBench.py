@@ -0,0 +1,84 @@
+############################################
+#
+# AVRCollideBench.py
+#
+# Measures AVRSprite.collide calls per second against groups of asteroids of
+# growing size, as onCollide makes them. Each call tests a bullet at a new
+# random position. Every count is run twice: with the group's spatial hash,
+# and with every sprite of the group as a candidate, the way the broad phase
+# worked before the hash. The hits found must be the same both ways.
+#
+#   python AVRCollideBench.py [calls] [image directory]
+#
+# Masks come from the shared cache in both runs, so the difference is the
+# broad phase alone. No display is opened.
+#
+############################################
+
+import os, random, sys, time
+
+#must be set before pygame starts
+os.environ['SDL_VIDEODRIVER'] = 'dummy'
+
+from pygame import display
+
+from AVRSprite import AVRSprite
+from AVRGroup import AVRGroup
+
+COUNTS = (25, 50, 100, 200)
+SCREEN_W, SCREEN_H = 800, 600
+AST_SIZES = (15, 40, 100)			#AST_SIZE_1..3 in asteroids.c
+BULLET_SIZE = 6
+
+def scanAll(group):
+	#a broad phase which offers every sprite of the group
+	return lambda sprite: group.sprites
+
+def measure(count, calls, scan):
+	rng = random.Random(count)
+	group = AVRGroup()
+	asteroids = []
+	for i in range(count):
+		size = rng.choice(AST_SIZES)
+		s = AVRSprite('ast%d.png' % rng.randint(1, 3), (rng.randrange(SCREEN_W), rng.randrange(SCREEN_H)),
+		              rng.randrange(360), (size, size), 1)
+		group.addSprite(s)
+		asteroids.append(s)
+	bullet = AVRSprite('bullet.png', (0, 0), 0, (BULLET_SIZE, BULLET_SIZE), 1)
+	if scan:
+		group.candidates = scanAll(group)
+
+	positions = [(rng.randrange(SCREEN_W), rng.randrange(SCREEN_H)) for i in range(calls)]
+	#the first pass fills the mask cache, the second is timed
+	for timed in (False, True):
+		hits = 0
+		start = time.time()
+		for pos in positions:
+			bullet.setPos(pos)
+			hits += len(bullet.collide(group))
+		elapsed = time.time() - start
+
+	bullet.delete()
+	for s in asteroids:
+		s.delete()
+	group.delete()
+	return calls / elapsed if elapsed else 0.0, hits
+
+def run(calls):
+	display.set_mode((SCREEN_W, SCREEN_H))
+	print "%d calls per run" % calls
+	print "%8s %14s %14s %8s %6s" % ("sprites", "hash calls/s", "scan calls/s", "speedup", "hits")
+	for count in COUNTS:
+		hashRate, hashHits = measure(count, calls, False)
+		scanRate, scanHits = measure(count, calls, True)
+		if hashHits != scanHits:
+			print "%8d hits differ: %d with the hash, %d scanning" % (count, hashHits, scanHits)
+			sys.exit(1)
+		print "%8d %14.0f %14.0f %7.1fx %6d" % (count, hashRate, scanRate, hashRate / scanRate if scanRate else 0.0, hashHits)
+
+if __name__ == '__main__':
+	calls = int(sys.argv[1]) if len(sys.argv) > 1 else 5000
+	images = sys.argv[2] if len(sys.argv) > 2 else os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'Python Exe')
+	#sprites load their images by name from the working directory
+	os.chdir(images)
+	run(calls)
@@ -25,11 +25,98 @@ CREATE_WINDOW = 0x0A
 
 PRINT = 0x0B
 
+BEGIN_FRAME = 0x0E
+SPRITE_BATCH = 0x0F
+END_FRAME = 0x10
+SPRITE_DELTA = 0x11
+
+REQUEST_TAG = 0x12		#next reply is sent as: tag, payload length, payload
+
+NEGOTIATE_BAUD = 0x13	#offer of a faster link; answered with 1 to switch or 0 to stay
+LINK_PROBE = 0x14		#sent each way at the new rate, followed by LINK_PROBE_PATTERN
+LINK_PROBE_PATTERN = 0xA5
+
+REGISTER_IMAGE = 0x15		#answered with a one-byte image id
+CREATE_SPRITE_BY_ID = 0x16	#CREATE_SPRITE with a registered image id in place of the filename
+
+CREATE_INTO_GROUP = 0x17	#answered with the handle of each sprite created
+CLEAR_GROUP = 0x18			#answered with the number of sprites deleted
+DELETE_SPRITES = 0x19		#answered with the number of sprites deleted
+
+RUN_TIME_STATS = 0x1A		#each task's run time; see AVRRunTimeStats.py
+
+TRACE_NAME = 0x1B			#name of a task (kind 0) or queue (kind 1) in the trace that follows
+TRACE_RECORDS = 0x1C		#trace records, oldest first; see AVRTraceViewer.py
+TRACE_END = 0x1D			#end of a trace, with the number of records lost before it
+
+LINK_TEST = 0x1E			#bytes 0, 1, 2... sent by the AVR after the probe echo, to check and time the new rate
+LINK_CONFIRM = 0x1F			#sent each way once LINK_TEST arrived intact; only then is the new rate kept
+
 INT8 = 0x01
 INT16 = 0x02
 STRING = 0x03
+BLOB = 0x04		#one length byte followed by that many bytes
+
+#SPRITE_BATCH record: handle, then x (11 bits), y (11 bits), angle (10 bits)
+BATCH_RECORD = '>BI'
+BATCH_RECORD_SIZE = 5
+
+#CREATE_INTO_GROUP record: image id, then the arguments of CREATE_SPRITE_BY_ID after it
+CREATE_RECORD = '>BHHHHHB'
+CREATE_RECORD_SIZE = 12
+
+#SPRITE_DELTA record: handle, mode, then the fields selected by the mode bits
+DELTA_POS_MASK = 0x03
+DELTA_POS_NONE = 0x00
+DELTA_POS_NIBBLE = 0x01
+DELTA_POS_BYTE = 0x02
+DELTA_POS_ABS = 0x03
+DELTA_ROT_MASK = 0x0C
+DELTA_ROT_NONE = 0x00
+DELTA_ROT_BYTE = 0x04
+DELTA_ROT_ABS = 0x08
+
+#argument types of each command, in the order they are sent
+ARGUMENTS = {
+	CREATE_SPRITE: [STRING, INT16, INT16, INT16, INT16, INT16, INT8],
+	SET_POS: [INT8, INT16, INT16],
+	SET_ROT: [INT8, INT16],
+	SET_ORDER: [INT8, INT8],
+	SET_SIZE: [INT8, INT16, INT16],
+	DELETE_SPRITE: [INT8],
+	CREATE_GROUP: [],
+	ADD_TO_GROUP: [INT8, INT8],
+	REMOVE_FROM_GROUP: [INT8, INT8],
+	DELETE_GROUP: [INT8],
+	COLLIDE: [INT8, INT8],
+	CREATE_WINDOW: [INT16, INT16],
+	PRINT: [STRING],
+	BEGIN_FRAME: [],
+	SPRITE_BATCH: [BLOB],
+	END_FRAME: [],
+	SPRITE_DELTA: [BLOB],
+	REQUEST_TAG: [INT8],
+	NEGOTIATE_BAUD: [INT16],
+	LINK_PROBE: [INT8],
+	REGISTER_IMAGE: [STRING],
+	CREATE_SPRITE_BY_ID: [INT8, INT16, INT16, INT16, INT16, INT16, INT8],
+	CREATE_INTO_GROUP: [INT8, BLOB],
+	CLEAR_GROUP: [INT8],
+	DELETE_SPRITES: [BLOB],
+	RUN_TIME_STATS: [BLOB],
+	TRACE_NAME: [INT8, INT8, STRING],
+	TRACE_RECORDS: [BLOB],
+	TRACE_END: [INT16],
+	LINK_TEST: [BLOB],
+	LINK_CONFIRM: [],
+}
 
 ALL_GROUP = 0x00
 HANDLE_ERROR = 0xFF
 
-BAUD_RATE = 38400
+BAUD_RATE = 38400		#rate the link starts at and falls back to
+MAX_BAUD_RATE = 1000000	#fastest rate accepted from NEGOTIATE_BAUD
+LINK_SETTLE = 0.01		#seconds given to the AVR to switch rates before the probe
+LINK_TEST_LENGTH = 255	#bytes in the AVR's LINK_TEST
+
+RENDER_FPS = 60		#frames the host draws per second at most
@@ -0,0 +1,123 @@
+############################################
+#
+# AVRDecoder.py
+#
+# Splits the byte stream sent by the AVR into commands.
+#
+# Run on its own to time the decoder on a file of raw bytes captured from
+# the AVR:  python AVRDecoder.py <stream file>
+#
+############################################
+
+import struct, sys, time
+
+import AVRConstants as const
+from AVRConstants import INT8, INT16, STRING, BLOB
+
+class AVRDecoder(object):
+	class exception(Exception):
+		pass
+
+	def __init__(self, arguments=const.ARGUMENTS):
+		self.buffer = bytearray()
+		self.offset = 0						#start of the first byte not yet decoded
+		self.size = 0						#bytes taken by the command next() last returned
+
+		#each command's arguments compiled once into decoding steps
+		self.steps = {}
+		for command, types in arguments.items():
+			self.steps[command] = AVRDecoder.compile(types)
+
+	@staticmethod
+	def compile(types):
+		#runs of integer arguments are read with a single precompiled struct;
+		#strings and blobs are left as their type and read separately
+		steps = []
+		fmt = ''
+		for t in types:
+			if t == INT8:
+				fmt += 'B'
+			elif t == INT16:
+				fmt += 'H'
+			else:
+				if fmt:
+					steps.append(struct.Struct('>' + fmt))
+					fmt = ''
+				steps.append(t)
+		if fmt:
+			steps.append(struct.Struct('>' + fmt))
+		return steps
+
+	def feed(self, data):
+		#drop what has been decoded before growing the buffer
+		if self.offset:
+			del self.buffer[:self.offset]
+			self.offset = 0
+		self.buffer.extend(data)
+
+	def next(self):
+		#returns (command, args) for the next complete command, or None if
+		#the rest of the buffer is only part of one
+		buf = self.buffer
+		end = len(buf)
+		pos = self.offset
+		if pos >= end:
+			return None
+
+		command = buf[pos]
+		pos += 1
+		if command not in self.steps:
+			raise AVRDecoder.exception('Command %d not recognized' % command)
+
+		args = []
+		for step in self.steps[command]:
+			if step == STRING:
+				stop = buf.find('\x00', pos)
+				if stop < 0:
+					return None
+				args.append(str(buf[pos:stop]))
+				pos = stop + 1
+			elif step == BLOB:
+				if pos >= end or pos + 1 + buf[pos] > end:
+					return None
+				length = buf[pos]
+				args.append(str(buf[pos + 1:pos + 1 + length]))
+				pos += 1 + length
+			else:
+				if pos + step.size > end:
+					return None
+				args.extend(step.unpack_from(buf, pos))
+				pos += step.size
+
+		self.size = pos - self.offset
+		self.offset = pos
+		return command, args
+
+	def commands(self):
+		#every complete command in the buffer, in order
+		while True:
+			decoded = self.next()
+			if decoded is None:
+				return
+			yield decoded
+
+if __name__ == '__main__':
+	if len(sys.argv) < 2:
+		print "usage: AVRDecoder <stream file>"
+		sys.exit(1)
+
+	stream = open(sys.argv[1], 'rb').read()
+	decoder = AVRDecoder()
+	count = 0
+
+	start = time.time()
+	#feed the stream in serial-sized reads
+	for i in range(0, len(stream), 256):
+		decoder.feed(stream[i:i + 256])
+		for command, args in decoder.commands():
+			count += 1
+	elapsed = time.time() - start
+
+	print "%d commands in %d bytes decoded in %.3f s" % (count, len(stream), elapsed)
+	if elapsed > 0:
+		print "%.0f commands/s" % (count / elapsed)
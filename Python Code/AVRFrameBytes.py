@@ -0,0 +1,244 @@
+############################################
+#
+# AVRFrameBytes.py
+#
+# Counts the bytes a game's sprite transforms cost on the link with each of
+# the encodings the AVR has used:
+#   per-sprite  a SET_POS and a SET_ROT for every object every frame
+#   batch       BEGIN_FRAME, packed 5-byte SPRITE_BATCH records, END_FRAME
+#   delta       as graphics.c sends them now: unchanged sprites are left out
+#               and small changes go as SPRITE_DELTA records
+#
+#   python AVRFrameBytes.py [frames]      a simulated game, seeded, so every
+#                                         run gives the same counts
+#   python AVRFrameBytes.py <capture>     the frames in a capture recorded
+#                                         with AVRGraphicsModule.py --capture
+#
+# The simulated game moves 40 asteroids, 20 bullets and the ship at the
+# speeds asteroids.c uses. For a capture, delta is the bytes the frames took
+# in the capture. A capture only has the sprites which changed in each frame,
+# so per-sprite and batch count those alone.
+#
+############################################
+
+import os, random, struct, sys
+
+import AVRConstants as const
+import AVRCapture
+from AVRDecoder import AVRDecoder
+
+SET_POS_BYTES = 6			#opcode, handle, x, y
+SET_ROT_BYTES = 4			#opcode, handle, angle
+BATCH_BUFFER = 250			#batchBuffer in graphics.c, 5 * BATCH_MAX_RECORDS
+SHADOW_SIZE = 64			#shadows in graphics.c, indexed by handle & (SHADOW_SIZE - 1)
+LINK_BAUD = 38400
+
+#as in asteroids.c
+SCREEN_W, SCREEN_H = 800, 600
+ASTEROIDS, BULLETS = 40, 20
+AST_MAX_VEL = (2.0, 3.0, 4.0)
+AST_MAX_AVEL = (3, 6, 9)
+BULLET_VEL = 6.0
+BULLET_LIFE_FRAMES = 100
+SHIP_AVEL = 6
+
+class BatchEncoder(object):
+	#the byte count of vFrameBegin, vSpriteBatchTransform and vFrameEnd
+	def __init__(self, deltas):
+		self.deltas = deltas
+		self.shadows = {}					#slot -> (handle, x, y, angle)
+		self.command = None
+		self.length = 0
+		self.sent = 0
+
+	def remember(self, handle, x, y, angle):
+		#what creating the sprite does in graphics.c
+		self.shadows[handle & (SHADOW_SIZE - 1)] = (handle, x, y, angle)
+
+	def frame(self, transforms):
+		self.sent += 1
+		for handle, x, y, angle in transforms:
+			self.transform(handle, x, y, angle)
+		self.flush()
+		self.sent += 1
+		sent, self.sent = self.sent, 0
+		return sent
+
+	def transform(self, handle, x, y, angle):
+		shadow = self.shadows.get(handle & (SHADOW_SIZE - 1))
+		if self.deltas and shadow is not None and shadow[0] == handle:
+			dx, dy, dAngle = x - shadow[1], y - shadow[2], angle - shadow[3]
+			self.shadows[handle & (SHADOW_SIZE - 1)] = (handle, x, y, angle)
+			length = 2
+			if dx == 0 and dy == 0:
+				pass
+			elif -8 <= dx <= 7 and -8 <= dy <= 7:
+				length += 1
+			elif -128 <= dx <= 127 and -128 <= dy <= 127:
+				length += 2
+			else:
+				length += 4
+			if dAngle == 0:
+				if length == 2:
+					return
+			elif -128 <= dAngle <= 127:
+				length += 1
+			else:
+				length += 2
+			self.reserve(const.SPRITE_DELTA, length)
+		else:
+			self.reserve(const.SPRITE_BATCH, const.BATCH_RECORD_SIZE)
+			length = const.BATCH_RECORD_SIZE
+		self.length += length
+
+	def reserve(self, command, length):
+		if self.command != command or self.length + length > BATCH_BUFFER:
+			self.flush()
+			self.command = command
+
+	def flush(self):
+		if self.length:
+			self.sent += 2 + self.length
+			self.length = 0
+
+def perSprite(transforms):
+	return len(transforms) * (SET_POS_BYTES + SET_ROT_BYTES)
+
+def simulate(frames):
+	#every object's transform in each frame of a seeded game
+	rng = random.Random(1)
+	free = range(1, 0xFE)					#handles, which come back when a bullet expires
+
+	def asteroid():
+		size = rng.randint(1, 3)
+		v = AST_MAX_VEL[size - 1]
+		return [free.pop(0), rng.uniform(0, SCREEN_W), rng.uniform(0, SCREEN_H),
+		        rng.uniform(-v, v), rng.uniform(-v, v), rng.randrange(360),
+		        rng.randint(-AST_MAX_AVEL[size - 1], AST_MAX_AVEL[size - 1])]
+
+	def bullet(ship):
+		heading = rng.randrange(0, 360, SHIP_AVEL)
+		dx, dy = rng.choice(((1, 0), (-1, 0), (0, 1), (0, -1), (0.7, 0.7), (-0.7, 0.7)))
+		return [free.pop(0), ship[1], ship[2], BULLET_VEL * dx, BULLET_VEL * dy, heading, 0,
+		        rng.randrange(BULLET_LIFE_FRAMES)]
+
+	ship = [free.pop(0), SCREEN_W / 2.0, SCREEN_H / 2.0, 0.0, 0.0, 0, 0]
+	asteroids = [asteroid() for i in range(ASTEROIDS)]
+	bullets = [bullet(ship) for i in range(BULLETS)]
+	created = [ship] + asteroids + bullets
+
+	for frame in range(frames):
+		#the player turns a third of the time
+		ship[6] = rng.choice((0, 0, 0, 0, SHIP_AVEL, -SHIP_AVEL))
+		for i, b in enumerate(bullets):
+			b[7] += 1
+			if b[7] >= BULLET_LIFE_FRAMES:
+				free.append(b[0])
+				bullets[i] = b = bullet(ship)
+				created.append(b)
+		for o in [ship] + asteroids + bullets:
+			o[1] = (o[1] + o[3]) % SCREEN_W
+			o[2] = (o[2] + o[4]) % SCREEN_H
+			o[5] = (o[5] + o[6]) % 360
+		yield [(o[0], o[1], o[2], o[5]) for o in created], \
+		      [(o[0], int(o[1]), int(o[2]), o[5]) for o in [ship] + asteroids + bullets], None
+		created = []
+
+def captureFrames(path):
+	#the transforms of each frame in a capture, resolved to absolute values
+	decoder = AVRDecoder()
+	state = {}								#handle -> [x, y, angle]
+	frame = None
+	sent = 0								#bytes of the frame's commands in the capture
+	skip = 1								#the sync byte AVRInterface reads and throws away
+	for stamp, direction, data in AVRCapture.readCapture(path):
+		if direction != AVRCapture.FROM_AVR:
+			continue
+		if skip:
+			data, skip = data[skip:], max(0, skip - len(data))
+		decoder.feed(data)
+		for command, args in decoder.commands():
+			if frame is not None:
+				sent += decoder.size
+			if command == const.BEGIN_FRAME:
+				frame = {}
+				sent = decoder.size
+			elif command == const.END_FRAME and frame is not None:
+				yield [], [(h,) + tuple(state[h]) for h in sorted(frame)], sent
+				frame = None
+			elif command == const.SPRITE_BATCH:
+				for offset in range(0, len(args[0]), const.BATCH_RECORD_SIZE):
+					handle, packed = struct.unpack_from(const.BATCH_RECORD, args[0], offset)
+					state[handle] = [packed >> 21, (packed >> 10) & 0x7FF, packed & 0x3FF]
+					frame[handle] = True
+			elif command == const.SPRITE_DELTA:
+				for handle in decodeDeltas(args[0], state):
+					frame[handle] = True
+			elif command in (const.SET_POS, const.SET_ROT) and frame is not None:
+				s = state.setdefault(args[0], [0, 0, 0])
+				if command == const.SET_POS:
+					s[0], s[1] = args[1], args[2]
+				else:
+					s[2] = args[1]
+				frame[args[0]] = True
+
+def decodeDeltas(data, state):
+	#applies SPRITE_DELTA records to state, as AVRGraphicsModule.onSpriteDelta does
+	offset = 0
+	while offset < len(data):
+		handle, mode = struct.unpack_from('>BB', data, offset)
+		offset += 2
+		s = state.setdefault(handle, [0, 0, 0])
+		posMode = mode & const.DELTA_POS_MASK
+		if posMode == const.DELTA_POS_NIBBLE:
+			packed, = struct.unpack_from('>B', data, offset)
+			dx, dy = packed >> 4, packed & 0x0F
+			s[0] += dx - 16 if dx > 7 else dx
+			s[1] += dy - 16 if dy > 7 else dy
+			offset += 1
+		elif posMode == const.DELTA_POS_BYTE:
+			dx, dy = struct.unpack_from('>bb', data, offset)
+			s[0] += dx
+			s[1] += dy
+			offset += 2
+		elif posMode == const.DELTA_POS_ABS:
+			s[0], s[1] = struct.unpack_from('>HH', data, offset)
+			offset += 4
+		rotMode = mode & const.DELTA_ROT_MASK
+		if rotMode == const.DELTA_ROT_BYTE:
+			s[2] += struct.unpack_from('>b', data, offset)[0]
+			offset += 1
+		elif rotMode == const.DELTA_ROT_ABS:
+			s[2], = struct.unpack_from('>H', data, offset)
+			offset += 2
+		yield handle
+
+def measure(frames):
+	batch = BatchEncoder(False)
+	delta = BatchEncoder(True)
+	totals = {'per-sprite': 0, 'batch': 0, 'delta': 0}
+	count = 0
+	for created, transforms, sent in frames:
+		for handle, x, y, angle in created:
+			delta.remember(handle, int(x), int(y), angle)
+		totals['per-sprite'] += perSprite(transforms)
+		totals['batch'] += batch.frame(transforms)
+		totals['delta'] += delta.frame(transforms) if sent is None else sent
+		count += 1
+
+	if count == 0:
+		print "no frames"
+		return
+	print "%d frames" % count
+	print "%-12s %10s %10s %8s %14s" % ("encoding", "bytes", "per frame", "ratio", "ms at %d" % LINK_BAUD)
+	for name in ('per-sprite', 'batch', 'delta'):
+		perFrame = float(totals[name]) / count
+		print "%-12s %10d %10.1f %7.2fx %14.2f" % (name, totals[name], perFrame,
+			float(totals['per-sprite']) / totals[name] if totals[name] else 0.0,
+			perFrame * 10 * 1000 / LINK_BAUD)
+
+if __name__ == '__main__':
+	if len(sys.argv) > 1 and os.path.exists(sys.argv[1]):
+		measure(captureFrames(sys.argv[1]))
+	else:
+		measure(simulate(int(sys.argv[1]) if len(sys.argv) > 1 else 1000))
@@ -0,0 +1,89 @@
+############################################
+#
+# AVRFrameTime.py
+#
+# Times frames of 200 sprites which never move and 20 which move and turn
+# every frame, through the same path the game's frames take: the decoder
+# thread's changes are published as a snapshot, which the render thread
+# applies and draws. No display is opened.
+#
+#   python AVRFrameTime.py [--all-dirty] [frames] [image directory]
+#
+# Prints the average and worst time of the decoder's part (setPos, setAngle
+# and publish) and of the render thread's part (consume, draw and
+# display.update). The first frame, which loads and rotates every image, is
+# not counted. --all-dirty marks every sprite changed every frame, as
+# updateGraphics did before sprites tracked their own changes. The rotated
+# images still come from the shared cache, which updateGraphics did not have,
+# so this understates what that churn cost.
+#
+############################################
+
+import os, random, sys, time
+
+#must be set before pygame starts
+os.environ['SDL_VIDEODRIVER'] = 'dummy'
+
+import pygame
+from pygame import display
+
+from AVRSprite import AVRSprite
+
+STATIC = 200
+MOVING = 20
+SCREEN_W, SCREEN_H = 800, 600
+SPRITE_SIZE = 40
+MOVING_VEL = 2			#pixels per frame on each axis
+MOVING_AVEL = 3			#degrees per frame
+
+def run(frames, allDirty):
+	rng = random.Random(1)
+	disp = display.set_mode((SCREEN_W, SCREEN_H))
+	back = pygame.Surface((SCREEN_W, SCREEN_H))
+	AVRSprite.spriteDrawGroup.clear(disp, back)
+
+	def create():
+		return AVRSprite('ast%d.png' % rng.randint(1, 3), (rng.randrange(SCREEN_W), rng.randrange(SCREEN_H)),
+		                 rng.randrange(360), (SPRITE_SIZE, SPRITE_SIZE), 1)
+
+	static = [create() for i in range(STATIC)]
+	moving = [create() for i in range(MOVING)]
+	AVRSprite.publish(time.time())
+	AVRSprite.consume()
+	display.update(AVRSprite.spriteDrawGroup.draw(disp))
+
+	decode = []
+	render = []
+	for frame in range(frames):
+		start = time.time()
+		for s in moving:
+			s.setPos(((s.pos[0] + MOVING_VEL) % SCREEN_W, (s.pos[1] + MOVING_VEL) % SCREEN_H))
+			s.setAngle((s.angle + MOVING_AVEL) % 360)
+		if allDirty:
+			for s in static:
+				s.markDirty()
+		AVRSprite.publish(start)
+		published = time.time()
+		AVRSprite.consume()
+		display.update(AVRSprite.spriteDrawGroup.draw(disp))
+		drawn = time.time()
+		decode.append(published - start)
+		render.append(drawn - published)
+
+	print "%d static and %d moving sprites, %d frames%s" % (len(static), len(moving), frames, ", all dirty" if allDirty else "")
+	print "%-8s %10s %10s" % ("", "avg ms", "worst ms")
+	for name, times in (("decode", decode), ("render", render)):
+		print "%-8s %10.3f %10.3f" % (name, 1000.0 * sum(times) / len(times), 1000.0 * max(times))
+	total = sum(decode) + sum(render)
+	print "%.0f frames/s" % (frames / total if total else 0.0)
+
+if __name__ == '__main__':
+	args = sys.argv[1:]
+	allDirty = '--all-dirty' in args
+	if allDirty:
+		args.remove('--all-dirty')
+	frames = int(args[0]) if len(args) > 0 else 1000
+	images = args[1] if len(args) > 1 else os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'Python Exe')
+	#sprites load their images by name from the working directory
+	os.chdir(images)
+	run(frames, allDirty)
@@ -10,53 +10,79 @@
 
 import pygame
 from pygame import event, display
-import sys, os, imp
+import sys, os, imp, struct, time
 from threading import Thread, Semaphore
-from serial import Serial
 
 import AVRConstants as const
-from AVRConstants import INT8, INT16, STRING
+from AVRDecoder import AVRDecoder
 from AVRSprite import AVRSprite
+from AVRImageCache import AVRImageCache
 from AVRGroup import AVRGroup
+from AVRTransport import openTransport
+from AVRCapture import CaptureTransport
+from AVRRunTimeStats import AVRRunTimeStats
+from AVRTraceViewer import AVRTrace
 
 class AVRInterface(object):
 	class exception(Exception):
 		pass
 	
-	def __init__(self):
-		if len(sys.argv) < 2:
-			print "usage: AVRInterface <COM_PORT>"
-			return
-	
+	def __init__(self, sensor):
+		#sensor is the link to the AVR, from AVRTransport.openTransport
 		pygame.init()
 		self.displayInit = Semaphore(0)
 		self.windowInit = Semaphore(0)
 		self.running = True					#set to false if window is destroyed; stops sensor polling thread
+		self.frame = None					#transforms held back until END_FRAME; None outside a frame
+		self.decoder = AVRDecoder()
+		self.replyTag = None				#tag for the reply to the next command; None for untagged replies
+		self.pendingSince = None			#when the oldest command not yet handed to the render loop was read
+		self.lastRead = None				#when the bytes being decoded were read
+		self.latency = [0, 0.0, 0.0]		#snapshots drawn, total and worst seconds from read to display
+		self.runTimeStats = AVRRunTimeStats()
+		self.trace = AVRTrace('trace-')		#each trace's timeline is drawn to trace-<n>.png
 		
-		self.sensor = Serial(port=sys.argv[1], baudrate=const.BAUD_RATE, timeout=1)
-		self.sensor.write(chr(0xff))
-		print "Sent initialization 0xff"
+		self.sensor = sensor
 		
-		#function command to the python handle function and the argument types it takes
+		#function command to the python handle function; argument types are in AVRConstants.ARGUMENTS
 		self.mapping = {
-			const.CREATE_SPRITE: [self.onCreateSprite, [STRING, INT16, INT16, INT16, INT16, INT16, INT8]],
-			const.SET_POS: [self.onSetPos, [INT8, INT16, INT16]],
-			const.SET_ROT: [self.onSetRot, [INT8, INT16]],
-			const.SET_ORDER: [self.onSetOrder, [INT8, INT8]],
-			const.SET_SIZE: [self.onSetSize, [INT8, INT16, INT16]],
-			const.DELETE_SPRITE: [self.onDeleteSprite, [INT8]],
-			const.CREATE_GROUP: [self.onCreateGroup, []],
-			const.ADD_TO_GROUP: [self.onAddToGroup, [INT8, INT8]],
-			const.REMOVE_FROM_GROUP: [self.onRemoveFromGroup, [INT8, INT8]],
-			const.DELETE_GROUP: [self.onDeleteGroup, [INT8]],
-			const.COLLIDE: [self.onCollide, [INT8, INT8]],
-			const.CREATE_WINDOW: [self.onCreateWindow, [INT16, INT16]],
-			const.PRINT: [self.onPrint, [STRING]],
+			const.CREATE_SPRITE: self.onCreateSprite,
+			const.SET_POS: self.onSetPos,
+			const.SET_ROT: self.onSetRot,
+			const.SET_ORDER: self.onSetOrder,
+			const.SET_SIZE: self.onSetSize,
+			const.DELETE_SPRITE: self.onDeleteSprite,
+			const.CREATE_GROUP: self.onCreateGroup,
+			const.ADD_TO_GROUP: self.onAddToGroup,
+			const.REMOVE_FROM_GROUP: self.onRemoveFromGroup,
+			const.DELETE_GROUP: self.onDeleteGroup,
+			const.COLLIDE: self.onCollide,
+			const.CREATE_WINDOW: self.onCreateWindow,
+			const.PRINT: self.onPrint,
+			const.BEGIN_FRAME: self.onBeginFrame,
+			const.SPRITE_BATCH: self.onSpriteBatch,
+			const.END_FRAME: self.onEndFrame,
+			const.SPRITE_DELTA: self.onSpriteDelta,
+			const.REQUEST_TAG: self.onRequestTag,
+			const.NEGOTIATE_BAUD: self.onNegotiateBaud,
+			const.LINK_PROBE: self.onLinkProbe,
+			const.LINK_TEST: self.onLinkTest,
+			const.LINK_CONFIRM: self.onLinkConfirm,
+			const.REGISTER_IMAGE: self.onRegisterImage,
+			const.CREATE_SPRITE_BY_ID: self.onCreateSpriteById,
+			const.CREATE_INTO_GROUP: self.onCreateIntoGroup,
+			const.CLEAR_GROUP: self.onClearGroup,
+			const.DELETE_SPRITES: self.onDeleteSprites,
+			const.RUN_TIME_STATS: self.onRunTimeStats,
+			const.TRACE_NAME: self.onTraceName,
+			const.TRACE_RECORDS: self.onTraceRecords,
+			const.TRACE_END: self.onTraceEnd,
 		}
-		
-		self.run()
 	
 	def run(self):		
+		self.sensor.write(chr(0xff))
+		print "Sent initialization 0xff"
+		
 		Thread(target=self.pollAVR).start()
 		
 		#wait for the AVR to call CREATE_WINDOW
@@ -73,25 +99,41 @@ class AVRInterface(object):
 	def pygameMainloop(self):
 		print "Starting Render Loop"
 		
+		#the draw group only ever redraws what changed over this background
+		AVRSprite.spriteDrawGroup.clear(self.disp, self.back)
+		clock = pygame.time.Clock()
+		start = time.time()
+		startCPU = sum(os.times()[:2])
+		
 		while self.running:
 			for e in event.get():
 				if e.type == pygame.QUIT: 
 					self.running = False
+					print AVRImageCache.report()
+					print self.renderReport(time.time() - start, sum(os.times()[:2]) - startCPU)
 					sys.exit()
-					
-			#clear then delete things atomically
-			AVRSprite.deleteLock.acquire()
-			AVRSprite.spriteDrawGroup.clear(self.disp, self.back)
-			AVRSprite.onDelete()
-			AVRSprite.deleteLock.release()
-			
-			AVRSprite.updateGraphics()
 			
-			AVRSprite.spriteLock.acquire()
+			self.drawSnapshots()
+			clock.tick(const.RENDER_FPS)
+	
+	def drawSnapshots(self):
+		#snapshots are published by the serial thread at frame boundaries,
+		#so nothing here waits on it
+		arrival = AVRSprite.consume()
+		if arrival is not None:
 			display.update(AVRSprite.spriteDrawGroup.draw(self.disp))
-			AVRSprite.spriteLock.release()
-			
-			AVRSprite.update()
+			elapsed = time.time() - arrival
+			self.latency[0] += 1
+			self.latency[1] += elapsed
+			self.latency[2] = max(self.latency[2], elapsed)
+	
+	def renderReport(self, wall, cpu):
+		drawn, total, worst = self.latency
+		average = 1000.0 * total / drawn if drawn else 0.0
+		lines = ["render: %d snapshots drawn, read to display %.1f ms average, %.1f ms worst" % (drawn, average, 1000.0 * worst)]
+		if wall > 0:
+			lines.append("cpu: %.0f%% of one core over %.0f s" % (100.0 * cpu / wall, wall))
+		return '\n'.join(lines)
 	
 	def onCreateSprite(self, file, x, y, angle, w, h, order):
 		try:
@@ -102,9 +144,28 @@ class AVRInterface(object):
 			return const.HANDLE_ERROR
 		return s.handle		
 	
+	def onRegisterImage(self, file):
+		try:
+			imageId = AVRImageCache.register(file)
+		except pygame.error:
+			print "ERROR: Could not load image: '%s'" % file
+			return const.HANDLE_ERROR
+		if imageId is None:
+			print "ERROR: No available image ids"
+			return const.HANDLE_ERROR
+		return imageId
+	
+	def onCreateSpriteById(self, imageId, x, y, angle, w, h, order):
+		file = AVRImageCache.registeredName(imageId)
+		if file is None:
+			print "createSpriteById: Unknown image id %d" % imageId
+			return const.HANDLE_ERROR
+		return self.onCreateSprite(file, x, y, angle, w, h, order)
+	
 	def onSetPos(self, handle, x, y):
+		#inside a frame, in order with the deltas around it
 		if handle in AVRSprite.spriteList:
-			AVRSprite.spriteList[handle].setPos((x,y))
+			self.queueTransforms([(handle, (x, y), False, None, False)])
 		else:
 			print "setPos: Unknown handle %d" % handle
 			raise AVRInterface.exception('onSetPos')
@@ -112,7 +173,7 @@ class AVRInterface(object):
 	
 	def onSetRot(self, handle, angle):
 		if handle in AVRSprite.spriteList:
-			AVRSprite.spriteList[handle].setAngle(angle)
+			self.queueTransforms([(handle, None, False, angle, False)])
 		else:
 			print "setAngle: Unknown handle %d" % handle
 			raise AVRInterface.exception('onSetRot')
@@ -142,6 +203,15 @@ class AVRInterface(object):
 			raise AVRInterface.exception('deleteSprite')
 		return -1
 		
+	def onDeleteSprites(self, data):
+		#handles no longer in use are skipped, so a list may be sent twice safely
+		deleted = 0
+		for handle in bytearray(data):
+			if handle in AVRSprite.spriteList:
+				AVRSprite.spriteList[handle].delete()
+				deleted += 1
+		return deleted
+	
 	def onCreateGroup(self):
 		g = AVRGroup()
 		if g.handle == -1:
@@ -177,6 +247,33 @@ class AVRInterface(object):
 			raise AVRInterface.exception('onDeleteGroup')
 		return -1
 		
+	def onCreateIntoGroup(self, groupHandle, data):
+		if groupHandle not in AVRGroup.groupList:
+			print "createIntoGroup: Unknown group handle %d" % groupHandle
+			raise AVRInterface.exception('onCreateIntoGroup')
+		if len(data) % const.CREATE_RECORD_SIZE != 0:
+			print "createIntoGroup: Bad record length %d" % len(data)
+			raise AVRInterface.exception('onCreateIntoGroup')
+		
+		group = AVRGroup.groupList[groupHandle]
+		handles = []
+		for offset in range(0, len(data), const.CREATE_RECORD_SIZE):
+			handle = self.onCreateSpriteById(*struct.unpack_from(const.CREATE_RECORD, data, offset))
+			if handle != const.HANDLE_ERROR:
+				group.addSprite(AVRSprite.spriteList[handle])
+			handles.append(handle)
+		return handles
+	
+	def onClearGroup(self, handle):
+		if handle not in AVRGroup.groupList:
+			print "clearGroup: Unknown group handle %d" % handle
+			raise AVRInterface.exception('onClearGroup')
+		
+		sprites = AVRGroup.groupList[handle].sprites[:]
+		for s in sprites:
+			s.delete()
+		return len(sprites)
+	
 	def onCollide(self, spriteHandle, groupHandle):
 		if groupHandle not in AVRGroup.groupList:
 			print "collide: Unknown group handle %d" % groupHandle
@@ -199,63 +296,272 @@ class AVRInterface(object):
 		print s
 		return -1
 	
+	def onRunTimeStats(self, data):
+		print self.runTimeStats.report(data)
+		return -1
+	
+	def onTraceName(self, kind, number, name):
+		self.trace.name(kind, number, name)
+		return -1
+	
+	def onTraceRecords(self, data):
+		self.trace.records(data)
+		return -1
+	
+	def onTraceEnd(self, lost):
+		print self.trace.end(lost)
+		return -1
+	
+	def onRequestTag(self, tag):
+		self.replyTag = tag
+		return -1
+	
+	def onNegotiateBaud(self, rate):
+		#rate is in hundreds of baud. the answer goes out at the old rate, then
+		#both ends switch, the probe is echoed back and the AVR sends LINK_TEST.
+		#the new rate is kept only once LINK_CONFIRM has gone each way; until
+		#then a lost or garbled byte puts both ends back at the old rate
+		rate *= 100
+		if rate > const.MAX_BAUD_RATE:
+			print "Link test at %d baud: skipped, above %d" % (rate, const.MAX_BAUD_RATE)
+			return 0
+		
+		old = self.sensor.baudrate
+		self.sensor.write(chr(1))
+		self.sensor.flush()
+		try:
+			self.sensor.baudrate = rate
+		except (ValueError, IOError):
+			#the AVR will miss the probe and fall back by itself
+			print "Link test at %d baud: skipped, the serial port can not run at it" % rate
+			return -1
+		
+		time.sleep(const.LINK_SETTLE)
+		probe = chr(const.LINK_PROBE) + chr(const.LINK_PROBE_PATTERN)
+		test = chr(const.LINK_TEST) + chr(const.LINK_TEST_LENGTH) + ''.join(chr(i) for i in range(const.LINK_TEST_LENGTH))
+		self.sensor.write(probe)
+		start = time.time()
+		reply = self.sensor.read(len(probe) + len(test))
+		elapsed = time.time() - start
+		#timed from the probe going out, so a slight underestimate; a byte is
+		#10 bits on the line
+		measured = len(reply) / max(elapsed, 0.001)
+		
+		if reply == probe + test:
+			self.sensor.write(chr(const.LINK_CONFIRM))
+			self.sensor.flush()
+			if self.sensor.read(1) == chr(const.LINK_CONFIRM):
+				print "Link test at %d baud: %d bytes/s measured (%d%% of the line rate), kept" % \
+					(rate, measured, 100 * measured * 10 / rate)
+				return -1
+			reason = "%d bytes/s measured, but no LINK_CONFIRM came back" % measured
+		elif len(reply) == 0:
+			reason = "no probe echo"
+		elif not reply.startswith(probe[:len(reply)]):
+			reason = "probe echo garbled"
+		elif len(reply) < len(probe + test):
+			reason = "timed out after %d of %d bytes" % (len(reply), len(probe + test))
+		else:
+			wrong = sum(1 for got, sent in zip(reply, probe + test) if got != sent)
+			reason = "%d of %d test bytes wrong" % (wrong, len(test))
+		
+		print "Link test at %d baud: failed, %s; staying at %d" % (rate, reason, old)
+		self.sensor.baudrate = old
+		#drop whatever arrived at the wrong rate
+		self.sensor.read(self.sensor.inWaiting())
+		return -1
+	
+	def onLinkProbe(self, pattern):
+		#the echo is read by onNegotiateBaud; this only sees it when replaying a capture
+		return -1
+	
+	def onLinkTest(self, data):
+		#as onLinkProbe
+		return -1
+	
+	def onLinkConfirm(self):
+		#as onLinkProbe
+		return -1
+	
+	def onBeginFrame(self):
+		self.frame = []
+		return -1
+	
+	def onSpriteBatch(self, data):
+		if len(data) % const.BATCH_RECORD_SIZE != 0:
+			print "spriteBatch: Bad batch length %d" % len(data)
+			raise AVRInterface.exception('onSpriteBatch')
+		
+		transforms = []
+		for offset in range(0, len(data), const.BATCH_RECORD_SIZE):
+			handle, packed = struct.unpack_from(const.BATCH_RECORD, data, offset)
+			if handle not in AVRSprite.spriteList:
+				print "spriteBatch: Unknown handle %d" % handle
+				raise AVRInterface.exception('onSpriteBatch')
+			transforms.append((handle, (packed >> 21, (packed >> 10) & 0x7FF), False, packed & 0x3FF, False))
+		
+		self.queueTransforms(transforms)
+		return -1
+	
+	def onSpriteDelta(self, data):
+		transforms = []
+		offset = 0
+		try:
+			while offset < len(data):
+				handle, mode = struct.unpack_from('>BB', data, offset)
+				offset += 2
+				if handle not in AVRSprite.spriteList:
+					print "spriteDelta: Unknown handle %d" % handle
+					raise AVRInterface.exception('onSpriteDelta')
+				
+				pos, posRelative = None, False
+				posMode = mode & const.DELTA_POS_MASK
+				if posMode == const.DELTA_POS_NIBBLE:
+					packed, = struct.unpack_from('>B', data, offset)
+					offset += 1
+					dx, dy = packed >> 4, packed & 0x0F
+					pos, posRelative = (dx - 16 if dx > 7 else dx, dy - 16 if dy > 7 else dy), True
+				elif posMode == const.DELTA_POS_BYTE:
+					pos, posRelative = struct.unpack_from('>bb', data, offset), True
+					offset += 2
+				elif posMode == const.DELTA_POS_ABS:
+					pos = struct.unpack_from('>HH', data, offset)
+					offset += 4
+				
+				angle, angleRelative = None, False
+				rotMode = mode & const.DELTA_ROT_MASK
+				if rotMode == const.DELTA_ROT_BYTE:
+					angle, = struct.unpack_from('>b', data, offset)
+					angleRelative = True
+					offset += 1
+				elif rotMode == const.DELTA_ROT_ABS:
+					angle, = struct.unpack_from('>H', data, offset)
+					offset += 2
+				
+				transforms.append((handle, pos, posRelative, angle, angleRelative))
+		except struct.error:
+			print "spriteDelta: Truncated record at offset %d" % offset
+			raise AVRInterface.exception('onSpriteDelta')
+		
+		self.queueTransforms(transforms)
+		return -1
+	
+	def queueTransforms(self, transforms):
+		if self.frame is None:
+			self.applyTransforms(transforms)
+		else:
+			self.frame.extend(transforms)
+	
+	def onEndFrame(self):
+		if self.frame is not None:
+			self.applyTransforms(self.frame)
+		self.frame = None
+		self.publish()
+		return -1
+	
+	def publish(self):
+		#the render loop only sees sprite state handed over here, so it never
+		#draws half a frame
+		AVRSprite.publish(self.pendingSince)
+		#the rest of the current read belongs to the next snapshot
+		self.pendingSince = self.lastRead
+	
+	def applyTransforms(self, transforms):
+		#deltas are resolved here, against the state the AVR last sent
+		for handle, pos, posRelative, angle, angleRelative in transforms:
+			if handle not in AVRSprite.spriteList:
+				continue
+			s = AVRSprite.spriteList[handle]
+			if pos is not None:
+				if posRelative:
+					pos = ((s.pos[0] + pos[0]) & 0xFFFF, (s.pos[1] + pos[1]) & 0xFFFF)
+				s.setPos(pos)
+			if angle is not None:
+				if angleRelative:
+					angle = (s.angle + angle) & 0xFFFF
+				s.setAngle(angle)
+	
 	def pollAVR(self):
         #read garbage bit from board to sync
 		self.sensor.read(1)
 
 		while (self.running):
-			command = self.sensor.read(1)
-			if len(command) != 1:
+			#block for at least one byte, then take whatever else has arrived
+			data = self.sensor.read(max(1, self.sensor.inWaiting()))
+			if len(data) == 0:
 				continue
-			command = ord(command)
-			#print command
-			#print command
-			if command not in self.mapping:
-				print "Command %s not recognized!" % command
-				self.running = False
+			if not self.receive(data):
 				return
-				
-			args = []
-			for arg in self.mapping[command][1]:
-				if arg == const.STRING:
-					data = ''
-					while True:
-						d = self.sensor.read(1)
-						print "got: " + str(d)
-						if len(d) != 1:
-							continue
-						if ord(d[0]) == 0x00:
-							break
-						data += d[0]
-					args.append(data)
-				else:
-					#read in 1 byte at a time and convert to appropriate sized integer
-					data = []
-					while len(data) != arg:
-						d = self.sensor.read(1)
-						print "got: " + str(d)
-						if len(d) == 1:
-							data.extend(d)
-					arg = 0
-					#receive high byte first, process low byte first
-					data.reverse()
-					for i, b in enumerate(data):
-						arg |= (ord(b) << (i*8)) & (0xff << i*8)
-					args.append(arg)	
-			try:
-				result = self.mapping[command][0](*args)
-			except AVRInterface.exception as e:
-				print "Exception:", e
-				self.running = False
-				sys.exit()
-				
+	
+	def receive(self, data):
+		#decodes and handles bytes read from the AVR; returns False if the stream
+		#can not be decoded
+		self.lastRead = time.time()
+		if self.pendingSince is None:
+			self.pendingSince = self.lastRead
+		self.decoder.feed(data)
+		
+		try:
+			for command, args in self.decoder.commands():
+				self.dispatch(command, args)
+		except AVRDecoder.exception as e:
+			print e
+			self.running = False
+			return False
+		
+		#changes made outside a frame are shown as soon as they are read
+		if self.frame is None:
+			self.publish()
+			self.pendingSince = None
+		return True
+	
+	def dispatch(self, command, args):
+		try:
+			result = self.mapping[command](*args)
+		except AVRInterface.exception as e:
+			print "Exception:", e
+			self.running = False
+			sys.exit()
+			
+		if command == const.REQUEST_TAG:
+			return
+		
+		if self.replyTag is not None:
+			#tagged replies carry their length instead of a terminator
 			if isinstance(result, list):
-				for r in result:
-					self.sensor.write(chr(r & 0xff))
-				self.sensor.write(chr(0xff))
+				payload = result
+			elif result != -1:
+				payload = [result]
 			else:
-				if result != -1:
-					self.sensor.write(chr(result & 0xff))
+				payload = []
+			self.sensor.write(chr(self.replyTag) + chr(len(payload)) + ''.join(chr(r & 0xff) for r in payload))
+			self.replyTag = None
+		elif isinstance(result, list):
+			self.sensor.write(''.join(chr(r & 0xff) for r in result) + chr(0xff))
+		else:
+			if result != -1:
+				self.sensor.write(chr(result & 0xff))
 					
 if __name__ == '__main__':
-	AVRInterface()
+	args = sys.argv[1:]
+	headless = '--headless' in args
+	if headless:
+		args.remove('--headless')
+	capture = None
+	if '--capture' in args and args.index('--capture') + 1 < len(args):
+		i = args.index('--capture')
+		capture = args[i + 1]
+		del args[i:i + 2]
+	if len(args) < 1:
+		print "usage: AVRInterface [--headless] [--capture <log>] <COM_PORT | tcp://host:port | pty | file:stream>"
+		sys.exit(1)
+	
+	if headless:
+		#draw into memory only, so no display is needed
+		os.environ['SDL_VIDEODRIVER'] = 'dummy'
+	
+	sensor = openTransport(args[0])
+	if capture is not None:
+		#replay the log with AVRReplay.py
+		sensor = CaptureTransport(sensor, capture)
+	AVRInterface(sensor).run()
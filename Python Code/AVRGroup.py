@@ -8,13 +8,13 @@
 #
 ############################################
 
-from pygame import sprite
 import AVRConstants as const
 import AVRSprite
 
 class AVRGroup(object):
 	availableHandles = [i for i in range(0xFE)]
 	groupList = {}
+	CELL_SIZE = 64			#pixels covered by one cell of a group's spatial hash
 	
 	def __init__(self, handle=None):
 		if len(AVRGroup.availableHandles) == 0:
@@ -28,30 +28,63 @@ class AVRGroup(object):
 			self.handle = const.ALL_GROUP
 		AVRGroup.groupList[self.handle] = self
 		
-		self.group = sprite.Group()
 		self.sprites = []
+		self.cells = {}		#(column, row) -> set of the sprites overlapping that cell
+	
+	@staticmethod
+	def cellRange(pos, radius):
+		#first and last column and row touched by a circle
+		size = AVRGroup.CELL_SIZE
+		return ((pos[0] - radius) // size, (pos[1] - radius) // size,
+		        (pos[0] + radius) // size, (pos[1] + radius) // size)
 	
 	def addSprite(self, sprite):
 		if sprite in self.sprites:
 			return
 			
-		self.group.add(sprite.sprite)
 		self.sprites.append(sprite)
 		sprite.groups.append(self)
+		self.moveSprite(sprite, None, sprite.cells)
 	
 	def removeSprite(self, sprite):
 		if sprite not in self.sprites:
 			return
 		
-		self.group.remove(sprite.sprite)
+		self.moveSprite(sprite, sprite.cells, None)
 		self.sprites.remove(sprite)
 		sprite.groups.remove(self)
 	
+	def moveSprite(self, sprite, old, new):
+		#old and new are cell ranges from cellRange, or None
+		if old is not None:
+			for cell in AVRGroup.cellsIn(old):
+				bucket = self.cells[cell]
+				bucket.discard(sprite)
+				if not bucket:
+					del self.cells[cell]
+		if new is not None:
+			for cell in AVRGroup.cellsIn(new):
+				self.cells.setdefault(cell, set()).add(sprite)
+	
+	def candidates(self, sprite):
+		#sprites of this group sharing at least one cell with the given sprite
+		found = set()
+		for cell in AVRGroup.cellsIn(sprite.cells):
+			if cell in self.cells:
+				found.update(self.cells[cell])
+		return found
+	
+	@staticmethod
+	def cellsIn(cells):
+		for column in range(cells[0], cells[2] + 1):
+			for row in range(cells[1], cells[3] + 1):
+				yield (column, row)
+	
 	def delete(self):
 		del AVRGroup.groupList[self.handle]
 		AVRGroup.availableHandles.append(self.handle)
 		
-		for sprite in self.sprites:
+		for sprite in self.sprites[:]:
 			self.removeSprite(sprite)
 		self.sprites = []
 		
@@ -0,0 +1,140 @@
+############################################
+#
+# AVRImageCache.py
+#
+# Shared surfaces for sprites, so an image is decoded and scaled once per
+# size, and rotated once per size and angle bucket, however many sprites use it.
+# Collision masks are shared the same way.
+#
+############################################
+
+from pygame import image, transform, mask
+from collections import OrderedDict
+from threading import Lock
+
+import AVRConstants as const
+
+class AVRImageCache(object):
+	ROTATION_STEP = 2				#degrees covered by one rotation bucket
+	ROTATION_CACHE_SIZE = 512		#entries kept in each rotation-keyed cache before the least recently used is dropped
+
+	loaded = {}						#filename -> decoded surface
+	registered = []					#image id -> filename, for images registered by the AVR
+	imageIds = {}					#filename -> image id
+	scaled = {}						#(filename, size) -> scaled surface
+	rotated = OrderedDict()			#(filename, size, bucket) -> rotated surface, oldest use first
+	masks = OrderedDict()			#(filename, size, bucket) -> mask of the rotated surface, oldest use first
+	lock = Lock()
+
+	hits = {'scaled': 0, 'rotated': 0, 'masks': 0}
+	misses = {'scaled': 0, 'rotated': 0, 'masks': 0}
+
+	@staticmethod
+	def getScaled(filename, size):
+		#raises pygame.error if the image can not be loaded
+		key = (filename, tuple(size))
+		AVRImageCache.lock.acquire()
+		try:
+			surface = AVRImageCache.scaled.get(key)
+			if surface is not None:
+				AVRImageCache.hits['scaled'] += 1
+				return surface
+			AVRImageCache.misses['scaled'] += 1
+
+			surface = transform.smoothscale(AVRImageCache.load(filename), key[1])
+			AVRImageCache.scaled[key] = surface
+			return surface
+		finally:
+			AVRImageCache.lock.release()
+
+	@staticmethod
+	def load(filename):
+		#the caller holds the lock. raises pygame.error if the image can not be loaded
+		surface = AVRImageCache.loaded.get(filename)
+		if surface is None:
+			surface = image.load(filename).convert_alpha()
+			AVRImageCache.loaded[filename] = surface
+		return surface
+	
+	@staticmethod
+	def register(filename):
+		#decodes the image now, so sprites created from the id never wait on it.
+		#returns the image's id, or None if every id is taken. raises
+		#pygame.error if the image can not be loaded
+		AVRImageCache.lock.acquire()
+		try:
+			if filename in AVRImageCache.imageIds:
+				return AVRImageCache.imageIds[filename]
+			if len(AVRImageCache.registered) >= const.HANDLE_ERROR:
+				return None
+			AVRImageCache.load(filename)
+			imageId = len(AVRImageCache.registered)
+			AVRImageCache.registered.append(filename)
+			AVRImageCache.imageIds[filename] = imageId
+			return imageId
+		finally:
+			AVRImageCache.lock.release()
+	
+	@staticmethod
+	def registeredName(imageId):
+		#the filename registered under imageId, or None
+		if imageId < len(AVRImageCache.registered):
+			return AVRImageCache.registered[imageId]
+		return None
+	
+	@staticmethod
+	def getRotated(filename, size, angle):
+		bucket = (angle % 360) // AVRImageCache.ROTATION_STEP
+		key = (filename, tuple(size), bucket)
+		surface = AVRImageCache.lookup('rotated', key)
+		if surface is None:
+			#getScaled takes the lock itself
+			surface = transform.rotate(AVRImageCache.getScaled(filename, size), bucket * AVRImageCache.ROTATION_STEP)
+		AVRImageCache.store('rotated', key, surface)
+		return surface
+
+	@staticmethod
+	def getMask(filename, size, angle):
+		#the mask of the surface getRotated returns for the same arguments
+		bucket = (angle % 360) // AVRImageCache.ROTATION_STEP
+		key = (filename, tuple(size), bucket)
+		m = AVRImageCache.lookup('masks', key)
+		if m is None:
+			m = mask.from_surface(AVRImageCache.getRotated(filename, size, angle))
+		AVRImageCache.store('masks', key, m)
+		return m
+
+	@staticmethod
+	def lookup(cache, key):
+		#takes key out of an LRU cache, making room for it if it is missing;
+		#the caller puts it back with store
+		lru = getattr(AVRImageCache, cache)
+		AVRImageCache.lock.acquire()
+		try:
+			value = lru.pop(key, None)
+			if value is not None:
+				AVRImageCache.hits[cache] += 1
+			else:
+				AVRImageCache.misses[cache] += 1
+				if len(lru) >= AVRImageCache.ROTATION_CACHE_SIZE:
+					lru.popitem(last=False)
+			return value
+		finally:
+			AVRImageCache.lock.release()
+
+	@staticmethod
+	def store(cache, key, value):
+		#(re)inserts key as the most recently used entry
+		AVRImageCache.lock.acquire()
+		getattr(AVRImageCache, cache)[key] = value
+		AVRImageCache.lock.release()
+
+	@staticmethod
+	def report():
+		lines = []
+		for cache in ('scaled', 'rotated', 'masks'):
+			total = AVRImageCache.hits[cache] + AVRImageCache.misses[cache]
+			rate = 100.0 * AVRImageCache.hits[cache] / total if total else 0.0
+			lines.append("%s: %d lookups, %.1f%% hits" % (cache, total, rate))
+		lines.append("images: %d, scaled: %d, rotated: %d, masks: %d" % (len(AVRImageCache.loaded), len(AVRImageCache.scaled), len(AVRImageCache.rotated), len(AVRImageCache.masks)))
+		return '\n'.join(lines)
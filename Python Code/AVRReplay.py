@@ -0,0 +1,170 @@
+############################################
+#
+# AVRReplay.py
+#
+# Feeds a capture recorded with AVRGraphicsModule.py --capture back through
+# the same decoder, handlers and renderer, with no AVR or display, and
+# reports where the time went.
+#
+#   python AVRReplay.py [--realtime] <capture>
+#
+# By default the capture is replayed as fast as it can be handled; with
+# --realtime each read is delayed until the time it originally arrived.
+# The replies the handlers send are checked against the recorded ones.
+#
+############################################
+
+import os, sys, time
+
+#must be set before pygame starts
+os.environ['SDL_VIDEODRIVER'] = 'dummy'
+
+import pygame
+from pygame import display
+
+import AVRConstants as const
+import AVRCapture
+from AVRGraphicsModule import AVRInterface
+from AVRSprite import AVRSprite
+
+class ReplaySink(object):
+	#stands in for the AVR, keeping the replies sent to it
+	baudrate = const.BAUD_RATE
+
+	def __init__(self):
+		self.replies = []
+
+	def write(self, data):
+		self.replies.append(data)
+
+	def flush(self):
+		pass
+
+	def read(self, size=1):
+		#only onNegotiateBaud reads directly; the recorded echo, LINK_TEST and
+		#LINK_CONFIRM are replayed through the decoder instead, so answer as a
+		#working link would. the confirmation is the one read of a single byte
+		if size == 1:
+			return chr(const.LINK_CONFIRM)
+		link = chr(const.LINK_PROBE) + chr(const.LINK_PROBE_PATTERN) + \
+			chr(const.LINK_TEST) + chr(const.LINK_TEST_LENGTH) + \
+			''.join(chr(i) for i in range(const.LINK_TEST_LENGTH))
+		return link[:size]
+
+	def inWaiting(self):
+		return 0
+
+class AVRReplay(object):
+	def __init__(self, path):
+		self.records = list(AVRCapture.readCapture(path))
+		self.sink = ReplaySink()
+		self.interface = AVRInterface(self.sink)
+		self.stats = {}						#opcode -> [commands, bytes, seconds handling them]
+		self.render = [0, 0.0]				#snapshots drawn, seconds drawing them
+
+		#there is no render thread to open the window, so do it here
+		self.interface.mapping[const.CREATE_WINDOW] = self.onCreateWindow
+		#time every handler by standing in for dispatch
+		self.dispatch = self.interface.dispatch
+		self.interface.dispatch = self.timedDispatch
+
+	def onCreateWindow(self, w, h):
+		interface = self.interface
+		interface.width, interface.height = w, h
+		interface.disp = display.set_mode((w, h))
+		interface.back = pygame.Surface((w, h))
+		AVRSprite.spriteDrawGroup.clear(interface.disp, interface.back)
+		return -1
+
+	def timedDispatch(self, command, args):
+		start = time.time()
+		self.dispatch(command, args)
+		elapsed = time.time() - start
+
+		stat = self.stats.setdefault(command, [0, 0, 0.0])
+		stat[0] += 1
+		stat[1] += self.interface.decoder.size
+		stat[2] += elapsed
+
+	def run(self, realtime):
+		#AVRInterface.run sends this before anything else
+		self.sink.write(chr(0xff))
+		recorded = []
+		skip = 1							#the sync byte pollAVR reads and throws away
+
+		start = time.time()
+		for stamp, direction, data in self.records:
+			if direction == AVRCapture.TO_AVR:
+				recorded.append(data)
+				continue
+			if skip:
+				data, skip = data[skip:], max(0, skip - len(data))
+				if not data:
+					continue
+
+			if realtime:
+				wait = stamp - (time.time() - start)
+				if wait > 0:
+					time.sleep(wait)
+
+			if not self.interface.receive(data):
+				break
+
+			drawStart = time.time()
+			if AVRSprite.published:
+				self.interface.drawSnapshots()
+				self.render[0] += 1
+				self.render[1] += time.time() - drawStart
+		elapsed = time.time() - start
+
+		self.report(elapsed)
+		self.checkReplies(''.join(recorded), ''.join(self.sink.replies))
+
+	def report(self, elapsed):
+		names = AVRReplay.commandNames()
+		totalCommands = totalBytes = 0
+		totalTime = 0.0
+		print "%-18s %8s %9s %10s %8s" % ("command", "count", "bytes", "ms", "us each")
+		for command in sorted(self.stats):
+			count, size, seconds = self.stats[command]
+			totalCommands += count
+			totalBytes += size
+			totalTime += seconds
+			print "%-18s %8d %9d %10.1f %8.1f" % (names.get(command, hex(command)), count, size, 1000.0 * seconds, 1000000.0 * seconds / count)
+		print "%-18s %8d %9d %10.1f" % ("handlers", totalCommands, totalBytes, 1000.0 * totalTime)
+
+		drawn, seconds = self.render
+		print "%-18s %8d %9s %10.1f %8.1f" % ("render", drawn, "", 1000.0 * seconds, 1000000.0 * seconds / drawn if drawn else 0.0)
+		print "replayed in %.3f s" % elapsed
+		if elapsed > 0:
+			print "%.0f commands/s, %.0f bytes/s" % (totalCommands / elapsed, totalBytes / elapsed)
+
+	def checkReplies(self, recorded, replayed):
+		#a difference means a handler (collide in particular) now answers differently
+		if recorded == replayed:
+			print "replies: %d bytes, all match the capture" % len(recorded)
+			return
+		first = next((i for i in range(min(len(recorded), len(replayed))) if recorded[i] != replayed[i]), min(len(recorded), len(replayed)))
+		print "replies: differ from the capture at byte %d (%d bytes recorded, %d replayed)" % (first, len(recorded), len(replayed))
+
+	@staticmethod
+	def commandNames():
+		#opcode -> name, from the commands AVRConstants gives argument types for
+		names = {}
+		for name in dir(const):
+			value = getattr(const, name)
+			if name.isupper() and not name.startswith('DELTA_') and name not in ('INT8', 'INT16', 'STRING', 'BLOB') \
+			   and isinstance(value, int) and value in const.ARGUMENTS:
+				names[value] = name
+		return names
+
+if __name__ == '__main__':
+	args = sys.argv[1:]
+	realtime = '--realtime' in args
+	if realtime:
+		args.remove('--realtime')
+	if len(args) < 1:
+		print "usage: AVRReplay [--realtime] <capture>"
+		sys.exit(1)
+
+	AVRReplay(args[0]).run(realtime)
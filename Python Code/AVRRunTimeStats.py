@@ -0,0 +1,100 @@
+############################################
+#
+# AVRRunTimeStats.py
+#
+# Decodes the RUN_TIME_STATS reports the AVR sends and prints each task's
+# share of the CPU, since the previous report and since the AVR started, and
+# the tickless idle wake-ups per second and share of time asleep since the
+# previous report.
+#
+# A report is the microsecond clock (uint32), the number of tickless sleeps
+# taken (uint32) and the CPU cycles spent in them (uint32), then for each task
+# its priority (uint8), its run time in microseconds (uint32) and its name
+# (null-terminated), all big-endian. The clock wraps after about 71 minutes;
+# shares since the previous report survive that, shares since start up do not.
+# The cycle count wraps after about 268 seconds, so only its change between
+# reports is used.
+#
+# Run on its own to print every report in a capture recorded with
+# AVRGraphicsModule.py --capture:  python AVRRunTimeStats.py <capture>
+#
+############################################
+
+import struct, sys
+
+import AVRConstants as const
+
+HEADER = struct.Struct('>III')
+TASK = struct.Struct('>BI')
+CYCLES_PER_US = 16					#run time stats need the 16MHz clock
+
+def decode(data):
+	#returns (total microseconds, sleeps, cycles asleep,
+	#         [(name, priority, microseconds), ...])
+	total, sleeps, cyclesAsleep = HEADER.unpack_from(data, 0)
+	tasks = []
+	pos = HEADER.size
+	while pos < len(data):
+		priority, runTime = TASK.unpack_from(data, pos)
+		pos += TASK.size
+		stop = data.index('\x00', pos)
+		tasks.append((data[pos:stop], priority, runTime))
+		pos = stop + 1
+	return total, sleeps, cyclesAsleep, tasks
+
+class AVRRunTimeStats(object):
+	def __init__(self):
+		self.previous = None				#(total, sleeps, cycles asleep, {name: run time}) of the last report
+
+	def report(self, data):
+		#the table for one report, as a string
+		total, sleeps, cyclesAsleep, tasks = decode(data)
+		lines = ["%-16s %4s %12s %8s %8s" % ("task", "prio", "us", "% now", "% boot")]
+
+		if self.previous is not None:
+			lastTotal, lastSleeps, lastCycles, lastTimes = self.previous
+			interval = (total - lastTotal) & 0xFFFFFFFF
+		else:
+			lastSleeps, lastCycles, lastTimes = 0, 0, {}
+			interval = total
+
+		for name, priority, runTime in sorted(tasks, key=lambda t: -t[2]):
+			delta = (runTime - lastTimes.get(name, 0)) & 0xFFFFFFFF
+			now = 100.0 * delta / interval if interval else 0.0
+			boot = 100.0 * runTime / total if total else 0.0
+			lines.append("%-16s %4d %12d %7.1f%% %7.1f%%" % (name, priority, runTime, now, boot))
+		lines.append("%-16s %4s %12d" % ("total", "", total))
+
+		#the counters only change while tickless idle is built in
+		if sleeps or cyclesAsleep:
+			wakeups = (sleeps - lastSleeps) & 0xFFFFFFFF
+			asleep = (cyclesAsleep - lastCycles) & 0xFFFFFFFF
+			lines.append("%-16s %4s %12d %7.1f/s %7.1f%% asleep" % ("sleeps", "", sleeps,
+				1e6 * wakeups / interval if interval else 0.0,
+				100.0 * asleep / (interval * CYCLES_PER_US) if interval else 0.0))
+
+		self.previous = (total, sleeps, cyclesAsleep, dict((name, runTime) for name, priority, runTime in tasks))
+		return '\n'.join(lines)
+
+if __name__ == '__main__':
+	import AVRCapture
+	from AVRDecoder import AVRDecoder
+
+	if len(sys.argv) < 2:
+		print "usage: AVRRunTimeStats <capture>"
+		sys.exit(1)
+
+	decoder = AVRDecoder()
+	stats = AVRRunTimeStats()
+	skip = 1								#the sync byte AVRInterface reads and throws away
+	for stamp, direction, data in AVRCapture.readCapture(sys.argv[1]):
+		if direction != AVRCapture.FROM_AVR:
+			continue
+		if skip:
+			data, skip = data[skip:], max(0, skip - len(data))
+		decoder.feed(data)
+		for command, args in decoder.commands():
+			if command == const.RUN_TIME_STATS:
+				print "at %.3f s" % stamp
+				print stats.report(args[0])
+				print
@@ -1,7 +1,9 @@
-from pygame import image, error, transform, sprite, mask
+from pygame import error, sprite
 import AVRGroup
 import AVRConstants as const
-from threading import Lock
+from AVRImageCache import AVRImageCache
+from collections import deque
+import math
 '''possible to load:
 JPG 
  PNG 
@@ -18,10 +20,9 @@ JPG
 class AVRSprite(object):
 	availableHandles = [i for i in range(0xFE)]
 	spriteList = {}
-	deletedSprites = []
-	spriteDrawGroup = sprite.LayeredDirty()
-	deleteLock = Lock()
-	spriteLock = Lock()
+	changedSprites = set()		#sprites created, changed or deleted since the last publish; decoder thread only
+	published = deque()			#(arrival time, records) snapshots waiting for the render thread
+	spriteDrawGroup = sprite.LayeredDirty()		#render thread only
 	
 	def __init__(self, filename, pos, angle, size, order):
 		self.pos = pos
@@ -30,135 +31,167 @@ class AVRSprite(object):
 		self.order = order
 		self.filename = filename
 		self.groups = []
+		self.radius = AVRSprite.boundingRadius(self.size)
+		self.cells = AVRGroup.AVRGroup.cellRange(self.pos, self.radius)
+		self.deleted = False
+		self.sprite = None			#created by the render thread when it first sees this sprite
 		
 		if len(AVRSprite.availableHandles) == 0:
 			print "ERROR: AVRSprite out of handles!"
 			self.handle = -1
 			return
 		
+		#load the image now so a bad filename is reported to the AVR; the render
+		#thread gets the same shared surface from the cache later
 		try:
-			self.surface = image.load(self.filename).convert_alpha()
+			AVRImageCache.getRotated(self.filename, self.size, self.angle)
 		except error as e:
 			print "ERROR: Could not load image: '%s'" % self.filename
 			raise e
 		
-		self.scaledSurface = transform.smoothscale(self.surface, self.size)
-		self.transformedSurface = transform.rotate(self.scaledSurface, self.angle)  
-		
-		self.sprite = sprite.DirtySprite()
-		self.sprite.image = self.transformedSurface
-		self.sprite.rect = self.transformedSurface.get_rect()
-		self.sprite.rect.center = self.pos
-		self.sprite.dirty = 1
-		self.sprite.maskDirty = True
-		self.sprite.AVRSprite = self
-		
-		self.posDirty = False
-		self.rotateDirty = False
-		self.sizeDirty = False
-		
-		AVRSprite.spriteDrawGroup.add(self.sprite, layer=self.order)
 		AVRGroup.AVRGroup.groupList[const.ALL_GROUP].addSprite(self)
 		self.handle = AVRSprite.availableHandles.pop()
 		AVRSprite.spriteList[self.handle] = self
+		self.markDirty()
 		
 		#print 'sprite %s with handle %s' % (self.filename, self.handle)
 		
 	def setOrder(self, order):			
+		if order == self.order:
+			return
 		self.order = order
-		AVRSprite.spriteDrawGroup.change_layer(self.sprite, order)
-		self.sprite.dirty = 1
+		self.markDirty()
 	
 	def setPos(self, pos):
+		if pos[0] == self.pos[0] and pos[1] == self.pos[1]:
+			return
+			
 		self.pos = pos
-		self.posDirty = True
+		self.rehash()
+		self.markDirty()
 	
 	def setAngle(self, angle):
 		if angle == self.angle:
 			return
 			
 		self.angle = angle
-		self.rotateDirty = True
+		self.markDirty()
 	
 	def setSize(self, size):
 		if size[0] == self.size[0] and size[1] == self.size[1]:
 			return
 		self.size = size[:]
-		
-		self.sizeDirty = True
+		self.radius = AVRSprite.boundingRadius(self.size)
+		self.rehash()
+		self.markDirty()
 				
+	def rehash(self):
+		#move the sprite between cells of its groups' spatial hashes
+		cells = AVRGroup.AVRGroup.cellRange(self.pos, self.radius)
+		if cells == self.cells:
+			return
+		for g in self.groups:
+			g.moveSprite(self, self.cells, cells)
+		self.cells = cells
+	
+	@staticmethod
+	def boundingRadius(size):
+		#covers the sprite at every angle, so rotating never moves it between cells
+		return int(math.ceil(math.hypot(size[0], size[1]) / 2.0))
+	
+	def markDirty(self):
+		AVRSprite.changedSprites.add(self)
+	
 	def delete(self):
-		#locks required because in order to delete, 
-		#the main thread must clear and then call AVRSprite.onDelete atomically
-		#also, this gaurantees the order of object deletion so no infinite reference loops occur
-		AVRSprite.deleteLock.acquire()
-		AVRSprite.deletedSprites.append(self)
-		self.sprite.dirty = 1
+		#the render thread drops the drawn sprite when the deletion is published
 		for g in self.groups[:]:
 			g.removeSprite(self)
 		self.groups = []
 		
-		self.sprite.AVRSprite = None
+		self.deleted = True
+		self.markDirty()
 		del AVRSprite.spriteList[self.handle]
 		AVRSprite.availableHandles.append(self.handle)
-		AVRSprite.deleteLock.release()
 	
 	def collide(self, group):
-		if self.sprite.maskDirty:
-			self.sprite.maskDirty = False
-			AVRSprite.spriteLock.acquire()
-			self.sprite.mask = mask.from_surface(self.transformedSurface)
-			AVRSprite.spriteLock.release()
-		
-		sprites = sprite.spritecollide(self.sprite, group.group, False)
+		#narrow phase works from the positions and angles last sent by the AVR,
+		#not the rects, which the render thread may not have caught up with yet
 		results = []
-		for s in sprites:
-			if s == self.sprite:
+		ownMask = None
+		for s in group.candidates(self):
+			if s is self:
 				continue
-			if s.maskDirty:
-				s.maskDirty = False
-				AVRSprite.spriteLock.acquire()
-				s.mask = mask.from_surface(s.AVRSprite.transformedSurface)
-				AVRSprite.spriteLock.release()
-			if sprite.collide_mask(self.sprite, s) != None:
-				results.append(s.AVRSprite.handle)
+			reach = self.radius + s.radius
+			dx = s.pos[0] - self.pos[0]
+			dy = s.pos[1] - self.pos[1]
+			if dx * dx + dy * dy > reach * reach:
+				continue
+			
+			if ownMask is None:
+				ownMask = AVRImageCache.getMask(self.filename, self.size, self.angle)
+				ownW, ownH = ownMask.get_size()
+			otherMask = AVRImageCache.getMask(s.filename, s.size, s.angle)
+			otherW, otherH = otherMask.get_size()
+			#offset between the top-left corners of the two centered masks
+			offset = (dx - otherW // 2 + ownW // 2, dy - otherH // 2 + ownH // 2)
+			if ownMask.overlap(otherMask, offset) is not None:
+				results.append(s.handle)
 		return results
 	
 	@staticmethod
-	def onDelete():
-		for s in AVRSprite.deletedSprites:
-			AVRSprite.spriteDrawGroup.remove(s.sprite)
-			s.sprite = None
-			
-		AVRSprite.deletedSprites = []
-		
-	@staticmethod
-	def update():
-		for s in AVRSprite.spriteList.values():
-			if s.posDirty or s.sizeDirty or s.rotateDirty:
-				s.sprite.dirty = 1
+	def publish(arrival):
+		#hands the state of every changed sprite to the render thread as one
+		#snapshot; called by the decoder thread at frame boundaries. arrival is
+		#when the oldest command in the snapshot was read
+		if not AVRSprite.changedSprites:
+			return
+		records = [(s, s.deleted, s.pos, s.angle, tuple(s.size), s.order) for s in AVRSprite.changedSprites]
+		AVRSprite.changedSprites = set()
+		AVRSprite.published.append((arrival, records))
 	
 	@staticmethod
-	def updateGraphics():
-		for s in AVRSprite.spriteList.values():
-			if s.sizeDirty:
-				s.scaledSurface = transform.smoothscale(s.surface, s.size)
-				s.transformedSurface = transform.rotate(s.scaledSurface, s.angle)
-				s.sprite.image = s.transformedSurface
-				s.sprite.rect = s.transformedSurface.get_rect()
-				s.sprite.rect.center = s.pos
-				s.sprite.maskDirty = True
-				
-			elif s.rotateDirty:
-				s.transformedSurface = transform.rotate(s.scaledSurface, s.angle)
-				s.sprite.image = s.transformedSurface
-				s.sprite.rect = s.transformedSurface.get_rect()
-				s.sprite.rect.center = s.pos
-				s.sprite.maskDirty = True
-				
-			elif s.posDirty:
-				s.sprite.rect.center = s.pos
-				s.posDirty = False
-			s.posDirty = True
-			s.rotateDirty = True
-			s.sizeDirty = True
+	def consume():
+		#applies every waiting snapshot to the draw group; called by the render
+		#thread only. deque appends and pops are atomic, so no lock is needed.
+		#returns the arrival time of the oldest snapshot, or None if there were none
+		oldest = None
+		latest = {}
+		while True:
+			try:
+				arrival, records = AVRSprite.published.popleft()
+			except IndexError:
+				break
+			if oldest is None:
+				oldest = arrival
+			#later snapshots replace earlier records of the same sprite
+			for r in records:
+				latest[r[0]] = r
+		
+		group = AVRSprite.spriteDrawGroup
+		for s, deleted, pos, angle, size, order in latest.itervalues():
+			drawn = s.sprite
+			if deleted:
+				if drawn is not None:
+					group.remove(drawn)
+					s.sprite = None
+				continue
+			
+			if drawn is None:
+				drawn = sprite.DirtySprite()
+				drawn.shape = None
+				drawn.order = order
+				group.add(drawn, layer=order)
+				s.sprite = drawn
+			elif drawn.order != order:
+				drawn.order = order
+				group.change_layer(drawn, order)
+			
+			#only look up a new surface when the size or rotation bucket changed
+			shape = (size, (angle % 360) // AVRImageCache.ROTATION_STEP)
+			if shape != drawn.shape:
+				drawn.shape = shape
+				drawn.image = AVRImageCache.getRotated(s.filename, size, angle)
+				drawn.rect = drawn.image.get_rect()
+			drawn.rect.center = pos
+			drawn.dirty = 1
+		return oldest
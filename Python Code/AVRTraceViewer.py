@@ -0,0 +1,319 @@
+############################################
+#
+# AVRTraceViewer.py
+#
+# Rebuilds the kernel trace the AVR sends when a frame overruns (TRACE_NAME,
+# TRACE_RECORDS and TRACE_END, from vTraceReport) into a timeline of which
+# task ran when. Prints a text Gantt chart, how long each task ran, histograms
+# of how long each task waited between being made ready and running and of
+# the period between marks, and what each queue did. With --png the chart is
+# also drawn to an image.
+#
+# A record is event and object (uint8 each), then bits 17..2 of the AVR's
+# microsecond clock (uint16), little-endian. A CLOCK record carries bits
+# 31..18 of the clock for the records after it.
+#
+# Run on its own to report every trace in a capture recorded with
+# AVRGraphicsModule.py --capture:
+#   python AVRTraceViewer.py [--png <prefix>] <capture>
+#
+############################################
+
+import struct, sys
+
+import AVRConstants as const
+
+RECORD = struct.Struct('<BBH')
+
+#events, as numbered in trace.h
+CLOCK = 0
+SWITCHED_IN = 1
+READY = 2
+DELAY = 3
+DELAY_UNTIL = 4
+QUEUE_SEND = 5
+QUEUE_SEND_FAILED = 6
+QUEUE_RECEIVE = 7
+QUEUE_RECEIVE_FAILED = 8
+BLOCK_ON_SEND = 9
+BLOCK_ON_RECEIVE = 10
+QUEUE_SEND_FROM_ISR = 11
+QUEUE_RECEIVE_FROM_ISR = 12
+NOTIFY = 13
+NOTIFY_FROM_ISR = 14
+NOTIFY_TAKEN = 15
+TASK_CREATE = 16
+MARK = 17
+TRIGGER = 18
+
+NAME_TASK = 0
+NAME_QUEUE = 1
+
+#queue events -> column of the queue table
+QUEUE_COLUMNS = [
+	('send', (QUEUE_SEND,)),
+	('receive', (QUEUE_RECEIVE,)),
+	('isr', (QUEUE_SEND_FROM_ISR, QUEUE_RECEIVE_FROM_ISR)),
+	('blocked', (BLOCK_ON_SEND, BLOCK_ON_RECEIVE)),
+	('failed', (QUEUE_SEND_FAILED, QUEUE_RECEIVE_FAILED)),
+]
+
+WAIT_EDGES = [16 << i for i in range(12)]					#microseconds, up to 32ms
+PERIOD_EDGES = [1000 * i for i in range(1, 31)]			#microseconds, 1ms apart up to 30ms
+GANTT_COLUMNS = 100
+
+def decode(data):
+	#returns [(microseconds from the first record, event, object)], leaving out CLOCK records
+	raw = [RECORD.unpack_from(data, i) for i in range(0, len(data) - RECORD.size + 1, RECORD.size)]
+
+	#records before the first CLOCK belong to the period before it; its own
+	#CLOCK was overwritten when the ring wrapped
+	high = 0
+	for event, obj, time in raw:
+		if event == CLOCK:
+			high = (time - 1) & 0x3FFF
+			break
+
+	events = []
+	wraps = 0
+	for event, obj, time in raw:
+		if event == CLOCK:
+			if time < high:
+				wraps += 1
+			high = time
+			continue
+		events.append(((((wraps << 14) + high) << 18) | (time << 2), event, obj))
+
+	if events:
+		start = events[0][0]
+		events = [(t - start, event, obj) for t, event, obj in events]
+	return events
+
+def histogram(values, edges, unit):
+	#one line per bucket from the first used to the last, with a bar scaled to the largest
+	counts = [0] * (len(edges) + 1)
+	for v in values:
+		i = 0
+		while i < len(edges) and v >= edges[i]:
+			i += 1
+		counts[i] += 1
+	used = [i for i in range(len(counts)) if counts[i]]
+	if not used:
+		return []
+
+	largest = max(counts)
+	lines = []
+	for i in range(used[0], used[-1] + 1):
+		if i < len(edges):
+			label = "< %d%s" % (edges[i] / unit[0], unit[1])
+		else:
+			label = ">= %d%s" % (edges[-1] / unit[0], unit[1])
+		lines.append("    %-9s %-40s %d" % (label, '#' * ((40 * counts[i] + largest - 1) // largest), counts[i]))
+	return lines
+
+def median(values):
+	ordered = sorted(values)
+	return ordered[len(ordered) // 2]
+
+class Timeline(object):
+	def __init__(self, events, tasks, queues):
+		self.events = events
+		self.tasks = tasks					#task number -> name
+		self.queues = queues				#queue number -> name
+		self.span = events[-1][0] if events else 0
+		self.segments = {}					#task -> [(start, end)] while it ran
+		self.waits = {}						#task -> [microseconds from ready to running]
+		self.marks = {}						#mark id -> [time]
+		self.queueEvents = {}				#queue -> {event: count}
+		self.trigger = None
+
+		running = None
+		runStart = 0
+		readyAt = {}
+		for t, event, obj in events:
+			if event == SWITCHED_IN:
+				if obj != running:
+					if running is not None:
+						self.segments.setdefault(running, []).append((runStart, t))
+					running, runStart = obj, t
+				if obj in readyAt:
+					self.waits.setdefault(obj, []).append(t - readyAt.pop(obj))
+			elif event == READY:
+				if obj != running and obj not in readyAt:
+					readyAt[obj] = t
+			elif event == MARK:
+				self.marks.setdefault(obj, []).append(t)
+			elif event == TRIGGER:
+				self.trigger = t
+			elif QUEUE_SEND <= event <= QUEUE_RECEIVE_FROM_ISR:
+				counts = self.queueEvents.setdefault(obj, {})
+				counts[event] = counts.get(event, 0) + 1
+		if running is not None:
+			self.segments.setdefault(running, []).append((runStart, self.span))
+
+	def taskName(self, number):
+		return self.tasks.get(number, 'task %d' % number)
+
+	def queueName(self, number):
+		return self.queues.get(number, 'queue %d' % number)
+
+	def taskOrder(self):
+		return sorted(set(self.segments) | set(self.waits), key=self.taskName)
+
+	def gantt(self):
+		#a row per task; '#' where it ran most of a column, '+' where it ran some of it
+		width = max(self.span, 1) / float(GANTT_COLUMNS)
+		lines = ["%-12s |%s| %.1f ms" % ("", "-" * GANTT_COLUMNS, self.span / 1000.0)]
+		for task in self.taskOrder():
+			busy = [0.0] * GANTT_COLUMNS
+			for start, end in self.segments.get(task, []):
+				column = int(start / width)
+				while column < GANTT_COLUMNS and column * width < end:
+					busy[column] += min(end, (column + 1) * width) - max(start, column * width)
+					column += 1
+			row = ''.join('#' if b > width / 2 else '+' if b > 0 else ' ' for b in busy)
+			lines.append("%-12s |%s|" % (self.taskName(task)[:12], row))
+
+		row = [' '] * GANTT_COLUMNS
+		for mark, times in self.marks.items():
+			for t in times:
+				row[min(int(t / width), GANTT_COLUMNS - 1)] = str(mark % 10)
+		if self.trigger is not None:
+			row[min(int(self.trigger / width), GANTT_COLUMNS - 1)] = 'T'
+		lines.append("%-12s |%s|" % ("marks", ''.join(row)))
+		return lines
+
+	def report(self):
+		lines = self.gantt()
+		lines.append('')
+		lines.append("%-12s %6s %10s %7s %10s %10s" % ("task", "runs", "ran ms", "%", "median us", "worst us"))
+		for task in self.taskOrder():
+			segments = self.segments.get(task, [])
+			ran = sum(end - start for start, end in segments)
+			waits = self.waits.get(task, [])
+			lines.append("%-12s %6d %10.2f %6.1f%% %10s %10s" % (self.taskName(task)[:12], len(segments), ran / 1000.0,
+				100.0 * ran / self.span if self.span else 0.0,
+				median(waits) if waits else '-', max(waits) if waits else '-'))
+
+		for task in self.taskOrder():
+			if task in self.waits:
+				lines.append("%s: ready to running" % self.taskName(task))
+				lines.extend(histogram(self.waits[task], WAIT_EDGES, (1, 'us')))
+
+		for mark in sorted(self.marks):
+			times = self.marks[mark]
+			periods = [b - a for a, b in zip(times, times[1:])]
+			if periods:
+				lines.append("mark %d: %d periods, %.2f to %.2f ms" % (mark, len(periods), min(periods) / 1000.0, max(periods) / 1000.0))
+				lines.extend(histogram(periods, PERIOD_EDGES, (1000, 'ms')))
+
+		if self.queueEvents:
+			lines.append("%-12s" % "queue" + ''.join("%9s" % name for name, events in QUEUE_COLUMNS))
+			for queue in sorted(self.queueEvents, key=self.queueName):
+				counts = self.queueEvents[queue]
+				lines.append("%-12s" % self.queueName(queue)[:12] + ''.join("%9d" % sum(counts.get(e, 0) for e in events) for name, events in QUEUE_COLUMNS))
+
+		if self.trigger is not None:
+			lines.append("triggered at %.3f ms" % (self.trigger / 1000.0))
+		return '\n'.join(lines)
+
+	def draw(self, path):
+		#the Gantt chart as an image: a bar per task, marks as ticks below, the trigger in red
+		import pygame
+		from pygame import draw, font, image
+
+		rowHeight, labelWidth, width = 20, 100, 1200
+		tasks = self.taskOrder()
+		height = rowHeight * (len(tasks) + 2)
+		scale = (width - labelWidth) / float(max(self.span, 1))
+		surface = pygame.Surface((width, height))
+		surface.fill((255, 255, 255))
+		font.init()
+		label = font.Font(None, 18)
+
+		for row, task in enumerate(tasks):
+			y = row * rowHeight
+			colour = ((row * 97) % 200, (row * 57 + 80) % 200, (row * 131 + 160) % 200)
+			surface.blit(label.render(self.taskName(task), True, (0, 0, 0)), (4, y + 3))
+			for start, end in self.segments.get(task, []):
+				draw.rect(surface, colour, (labelWidth + int(start * scale), y + 2, max(1, int((end - start) * scale)), rowHeight - 4))
+
+		y = len(tasks) * rowHeight
+		surface.blit(label.render("marks", True, (0, 0, 0)), (4, y + 3))
+		for mark, times in self.marks.items():
+			for t in times:
+				x = labelWidth + int(t * scale)
+				draw.line(surface, (0, 0, 0), (x, y + 2 + 4 * (mark % 4)), (x, y + rowHeight - 2))
+		if self.trigger is not None:
+			x = labelWidth + int(self.trigger * scale)
+			draw.line(surface, (255, 0, 0), (x, 0), (x, height))
+
+		surface.blit(label.render("%.1f ms" % (self.span / 1000.0), True, (0, 0, 0)), (width - 60, height - rowHeight + 3))
+		image.save(surface, path)
+
+class AVRTrace(object):
+	#collects one trace as it arrives and reports it at TRACE_END
+	def __init__(self, png=None):
+		self.png = png						#prefix of the image drawn for each trace, or None
+		self.count = 0
+		self.reset()
+
+	def reset(self):
+		self.tasks = {}
+		self.queues = {}
+		self.data = []
+
+	def name(self, kind, number, name):
+		if kind == NAME_TASK:
+			self.tasks[number] = name
+		elif kind == NAME_QUEUE:
+			self.queues[number] = name
+
+	def records(self, data):
+		self.data.append(data)
+
+	def end(self, lost):
+		#returns the report of the trace just finished
+		self.count += 1
+		timeline = Timeline(decode(''.join(self.data)), self.tasks, self.queues)
+		lines = ["trace %d: %d events over %.1f ms, %d records lost before them" % (self.count, len(timeline.events), timeline.span / 1000.0, lost)]
+		lines.append(timeline.report())
+		if self.png is not None:
+			path = '%s%d.png' % (self.png, self.count)
+			timeline.draw(path)
+			lines.append("timeline drawn to %s" % path)
+		self.reset()
+		return '\n'.join(lines)
+
+if __name__ == '__main__':
+	import AVRCapture
+	from AVRDecoder import AVRDecoder
+
+	args = sys.argv[1:]
+	png = None
+	if '--png' in args and args.index('--png') + 1 < len(args):
+		i = args.index('--png')
+		png = args[i + 1]
+		del args[i:i + 2]
+	if len(args) < 1:
+		print "usage: AVRTraceViewer [--png <prefix>] <capture>"
+		sys.exit(1)
+
+	decoder = AVRDecoder()
+	trace = AVRTrace(png)
+	skip = 1								#the sync byte AVRInterface reads and throws away
+	for stamp, direction, data in AVRCapture.readCapture(args[0]):
+		if direction != AVRCapture.FROM_AVR:
+			continue
+		if skip:
+			data, skip = data[skip:], max(0, skip - len(data))
+		decoder.feed(data)
+		for command, commandArgs in decoder.commands():
+			if command == const.TRACE_NAME:
+				trace.name(*commandArgs)
+			elif command == const.TRACE_RECORDS:
+				trace.records(commandArgs[0])
+			elif command == const.TRACE_END:
+				print "at %.3f s" % stamp
+				print trace.end(commandArgs[0])
+				print
@@ -0,0 +1,123 @@
+############################################
+#
+# AVRTransport.py
+#
+# The link to whatever is sending graphics commands. Besides the AVR's
+# serial port, a transport can be a TCP connection, a pseudo-terminal or a
+# file of bytes recorded from the AVR, so the host can be driven and timed
+# with no board attached.
+#
+#   COM3 or /dev/ttyUSB0	serial port at const.BAUD_RATE
+#   tcp://host:port			connect to a program listening on host:port
+#   pty						create a pseudo-terminal and print the name of its slave end
+#   file:<path>				replay a capture; replies are discarded
+#
+############################################
+
+import os, select, socket, time
+
+import AVRConstants as const
+
+TIMEOUT = 1		#seconds read waits for the bytes it was asked for, as for the serial port
+
+def openTransport(spec):
+	if spec.startswith('tcp://'):
+		host, port = spec[len('tcp://'):].rsplit(':', 1)
+		return SocketTransport(host, int(port))
+	elif spec == 'pty':
+		return PtyTransport()
+	elif spec.startswith('file:'):
+		return FileTransport(spec[len('file:'):])
+	else:
+		from serial import Serial
+		return Serial(port=spec, baudrate=const.BAUD_RATE, timeout=TIMEOUT)
+
+class Transport(object):
+	#the part of pySerial's interface AVRInterface uses: read, write and inWaiting.
+	#subclasses provide fill, which returns the bytes that arrive within timeout
+	#seconds, or '' if none do
+	baudrate = const.BAUD_RATE		#accepted and ignored; there is no line rate to set
+
+	def __init__(self):
+		self.buffer = ''
+
+	def flush(self):
+		pass
+
+	def read(self, size=1):
+		#blocks until size bytes have arrived or TIMEOUT passes
+		deadline = time.time() + TIMEOUT
+		while len(self.buffer) < size:
+			remaining = deadline - time.time()
+			if remaining <= 0:
+				break
+			self.buffer += self.fill(remaining)
+		data, self.buffer = self.buffer[:size], self.buffer[size:]
+		return data
+
+	def inWaiting(self):
+		self.buffer += self.fill(0)
+		return len(self.buffer)
+
+class SocketTransport(Transport):
+	def __init__(self, host, port):
+		Transport.__init__(self)
+		self.sock = socket.create_connection((host, port))
+		self.sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+		self.closed = False
+
+	def fill(self, timeout):
+		if self.closed:
+			time.sleep(timeout)
+			return ''
+		if not select.select([self.sock], [], [], timeout)[0]:
+			return ''
+		data = self.sock.recv(4096)
+		if not data:
+			print "transport: connection closed"
+			self.closed = True
+		return data
+
+	def write(self, data):
+		if not self.closed:
+			self.sock.sendall(data)
+
+class PtyTransport(Transport):
+	def __init__(self):
+		import tty
+		Transport.__init__(self)
+		self.master, self.slave = os.openpty()
+		#no echo or line editing, like a serial port
+		tty.setraw(self.slave)
+		print "transport: waiting on %s" % os.ttyname(self.slave)
+
+	def fill(self, timeout):
+		if not select.select([self.master], [], [], timeout)[0]:
+			return ''
+		try:
+			return os.read(self.master, 4096)
+		except OSError:
+			#nothing has the slave end open
+			time.sleep(timeout)
+			return ''
+
+	def write(self, data):
+		os.write(self.master, data)
+
+class FileTransport(Transport):
+	def __init__(self, path):
+		Transport.__init__(self)
+		self.file = open(path, 'rb')
+		self.done = False
+
+	def fill(self, timeout):
+		data = self.file.read(4096)
+		if not data:
+			if not self.done:
+				print "transport: end of capture"
+				self.done = True
+			time.sleep(timeout)
+		return data
+
+	def write(self, data):
+		pass
@@ -10,8 +10,9 @@
 *  the player destroys all of the asteroids, they win the game. If the player
 *  collides with an asteroid, they lose the game. In both the winning and losing
 *  conditions, the game pauses for three seconds and displays an appropriate
-*  message. It is recommended to compile the FreeRTOS portion of this project
-*  with heap_2.c instead of heap_1.c since pvPortMalloc and vPortFree are used.
+*  message. Bullets and asteroids are kept in fixed-size arrays rather than on
+*  the FreeRTOS heap, so at most MAX_BULLETS and MAX_ASTEROIDS may exist at
+*  once.
 *
 * Author(s): Doug Gallatin & Andrew Lehmer
 *
@@ -20,14 +21,18 @@
 *******************************************************************************/
 #include <avr/interrupt.h>
 #include <avr/io.h>
+#include <stdio.h>
 #include <stdlib.h>
-#include <math.h>
 
 #include "FreeRTOS.h"
 #include "task.h"
 #include "semphr.h"
 
+#include "benchmark.h"
+#include "buttons.h"
 #include "graphics.h"
+#include "collision.h"
+#include "fixed.h"
 #include "usart.h"
 
 const char *astImages[] = {
@@ -36,26 +41,28 @@ const char *astImages[] = {
 	"a3.png"
 };
 
+// a position in Q12.4 pixels or a velocity in Q8.8 pixels per frame
 typedef struct {
-	float x;
-	float y;
+	int16_t x;
+	int16_t y;
 } point;
 
-typedef struct object_s {
+typedef struct {
 	xSpriteHandle handle;
 	point pos;
 	point vel;
-	float accel;
+	int16_t accel;
 	int16_t angle;
 	int8_t a_vel;
-	uint8_t size;
-	uint16_t life;
-	struct object_s *next;
 } object;
 
-#define DEG_TO_RAD M_PI / 180.0
-
 #define INITIAL_ASTEROIDS 5
+// every initial asteroid broken down into size 1 pieces
+#define MAX_ASTEROIDS (INITIAL_ASTEROIDS * 9)
+// most asteroid sprites created in one message
+#define MAX_SPAWN INITIAL_ASTEROIDS
+// a bullet lives for two firing periods
+#define MAX_BULLETS 4
 #define SCREEN_W 800
 #define SCREEN_H 600
 
@@ -64,6 +71,13 @@ typedef struct object_s {
 #define FRAME_DELAY_MS  10
 #define BULLET_DELAY_MS 500
 #define BULLET_LIFE_MS  1000
+#define BULLET_LIFE_FRAMES (BULLET_LIFE_MS / FRAME_DELAY_MS)
+#define STATS_PERIOD_MS 5000
+#define STATS_LINE_LENGTH 56
+// after a trace is sent, recording resumes this long later
+#define TRACE_HOLDOFF_MS 2000
+#define TRACE_MARK_UPDATE 0
+#define TRACE_MARK_DRAW 1
 
 #define SHIP_SIZE 24
 #define BULLET_SIZE 6
@@ -71,53 +85,159 @@ typedef struct object_s {
 #define AST_SIZE_2 40
 #define AST_SIZE_1 15
 
-#define BULLET_VEL 6.0
+// radius of a circle covering a square sprite of the given size at every
+// angle, as the host's broad phase computes it, rounded up
+#define BOUNDING_RADIUS(size) ((uint8_t)(((size) * 182 + 255) >> 8))
+// hits kept per host collision test; the host still has asteroids which were
+// destroyed but not yet deleted, so the first hit may not be a live one
+#define MAX_QUERY_HITS 4
+#define NO_ASTEROID 0xFF
 
-#define SHIP_MAX_VEL 8.0
-#define SHIP_ACCEL 0.1
-#define SHIP_AVEL  6.0
+#define BULLET_VEL VEL_CONST(6.0)
 
-#define BACKGROUND_AVEL 0.01
+// compared against the squared speed, in Q16.16
+#define SHIP_MAX_VEL ((int32_t)8 << (2 * VEL_FRAC_BITS))
+#define SHIP_ACCEL VEL_CONST(0.1)
+#define SHIP_AVEL  6
 
-#define AST_MAX_VEL_3 2.0
-#define AST_MAX_VEL_2 3.0
-#define AST_MAX_VEL_1 4.0
-#define AST_MAX_AVEL_3 3.0
-#define AST_MAX_AVEL_2 6.0
-#define AST_MAX_AVEL_1 9.0
+#define AST_MAX_VEL_3 VEL_CONST(2.0)
+#define AST_MAX_VEL_2 VEL_CONST(3.0)
+#define AST_MAX_VEL_1 VEL_CONST(4.0)
+#define AST_MAX_AVEL_3 3
+#define AST_MAX_AVEL_2 6
+#define AST_MAX_AVEL_1 9
+
+#define SCREEN_W_POS PIX_TO_POS(SCREEN_W)
+#define SCREEN_H_POS PIX_TO_POS(SCREEN_H)
 
 #define LEFT_BUTTON  _BV(PB7)
 #define RIGHT_BUTTON _BV(PB6)
 #define ACCEL_BUTTON _BV(PB1)
 #define SHOOT_BUTTON _BV(PB0)
+#define ALL_BUTTONS  (LEFT_BUTTON | RIGHT_BUTTON | ACCEL_BUTTON | SHOOT_BUTTON)
+
+// how often inputTask re-reads the pins if no change has been reported
+#define INPUT_RESYNC_MS 100
+
+/*
+ * Bullets and asteroids are stored as structures of arrays. The live entities
+ * of each kind are packed at the front of the arrays in no particular order;
+ * removing one moves the last live entity into its slot.
+ */
+typedef struct {
+	uint8_t count;
+	xSpriteHandle handle[MAX_BULLETS];
+	point pos[MAX_BULLETS];
+	point vel[MAX_BULLETS];
+	int16_t angle[MAX_BULLETS];
+	uint8_t life[MAX_BULLETS];
+} bulletStore;
+
+typedef struct {
+	uint8_t count;
+	xSpriteHandle handle[MAX_ASTEROIDS];
+	point pos[MAX_ASTEROIDS];
+	point vel[MAX_ASTEROIDS];
+	int16_t angle[MAX_ASTEROIDS];
+	int8_t a_vel[MAX_ASTEROIDS];
+	uint8_t size[MAX_ASTEROIDS];
+} asteroidStore;
+
+/*
+ * The simulation publishes what is to be drawn as a render frame. There are
+ * two frames: the simulation fills the one the draw task is not reading and
+ * then makes it the published one, so the draw task never sees a half-updated
+ * frame and never has to lock the game state.
+ */
+typedef struct {
+	xSpriteHandle handle;
+	uint16_t x;
+	uint16_t y;
+	uint16_t angle;
+} renderItem;
+
+typedef struct {
+	uint16_t seq;
+	portTickType publishTick;
+	uint8_t count;
+	renderItem items[1 + MAX_BULLETS + MAX_ASTEROIDS];
+} renderFrame;
 
-static xTaskHandle inputTaskHandle;
-static xTaskHandle bulletTaskHandle;
-static xTaskHandle updateTaskHandle;
+#define NO_FRAME 0xFF
+
+// a sprite removed from the game, deleted once frame seq has been drawn
+typedef struct {
+	xSpriteHandle handle;
+	uint16_t seq;
+} deadSprite;
+
+// enough for every sprite removed in two frames of heavy fire
+#define DEAD_SPRITE_QUEUE_LENGTH (4 * MAX_BULLETS)
 
 static xSemaphoreHandle usartMutex;
+static xSemaphoreHandle frameReady;
+static xSemaphoreHandle shootPressed;
+static xQueueHandle deadSprites;
 
 static object ship;
-static object *bullets = NULL;
-static object *asteroids = NULL;
+static bulletStore bullets;
+static asteroidStore asteroids;
+static volatile portBASE_TYPE shooting = pdFALSE;
+static volatile portBASE_TYPE fireRequest = pdFALSE;
+
+static renderFrame frames[2];
+static volatile uint8_t published = 0;
+static volatile uint8_t reading = NO_FRAME;
+static uint16_t frameSeq = 0;
+// ticks on which the simulation took longer than a frame
+static volatile uint16_t frameOverruns = 0;
+// frames drawn a frame or more after they were published, or skipped
+static volatile uint16_t framesLate = 0;
+// COLLIDE round trips, the frames which sent any, and all frames simulated,
+// since the last stats period
+static volatile uint16_t collideTrips = 0;
+static volatile uint16_t collideFrames = 0;
+static volatile uint16_t simulatedFrames = 0;
 
 static xGroupHandle astGroup;
 static xSpriteHandle background;
+// asteroids and bullets are spawned all game long, so they are created by id
+static xImageHandle astImageIds[3];
+static xImageHandle bulletImage;
+static xSpriteSpec astSpawns[MAX_SPAWN];
+// collision tests against the host's masks, kept off the update task's stack
+static uint8_t queryBullets[MAX_BULLETS];
+static xPendingReply queries[MAX_BULLETS + 1];
+static xSpriteHandle queryHits[MAX_BULLETS + 1][MAX_QUERY_HITS];
+static uint8_t queryHitCounts[MAX_BULLETS + 1];
 
+void registerImages(void);
 void init(void);
 void reset(void);
+void endGame(void);
+void publishFrame(void);
+void sendPositions(void);
+void reportCollideTrips(void);
+uint8_t findAsteroid(xSpriteHandle hits[], uint8_t hitCount);
+void retireSprite(xSpriteHandle handle);
 int16_t getRandStartPosVal(int16_t dimOver2);
-object *createAsteroid(float x, float y, float velx, float vely, int16_t angle, int8_t avel, int8_t size, object *nxt);
+int16_t getRandVel(int16_t maxVel);
+void createAsteroid(int16_t x, int16_t y, int16_t velx, int16_t vely, int16_t angle, int8_t avel, int8_t size);
+void createAsteroidSprites(uint8_t first);
+void removeAsteroid(uint8_t index);
 uint16_t sizeToPix(int8_t size);
-object *createBullet(float x, float y, float velx, float vely, object *nxt);
+void createBullet(int16_t x, int16_t y, int16_t velx, int16_t vely);
+void removeBullet(uint8_t index);
 void spawnAsteroid(point *pos, uint8_t size);
+void movePoint(point *pos, point *vel);
 
 /*------------------------------------------------------------------------------
  * Function: inputTask
  *
- * Description: This task polls PINB for the current button state to determine
- *  if the player should turn, accelerate, or both. This task never blocks, so
- *  it should run at the lowest priority above the idle task priority.
+ * Description: This task blocks until the button driver reports a change and
+ *  then determines if the player should turn, accelerate, shoot, or a
+ *  combination of these. It also wakes every INPUT_RESYNC_MS to re-read the
+ *  buttons in case a change was lost.
  *
  * param vParam: This parameter is not used.
  *----------------------------------------------------------------------------*/
@@ -127,69 +247,95 @@ void inputTask(void *vParam)
      * ship.accel stores if the ship is moving
      * ship.a_vel stores which direction the ship is moving in
      */
+	uint8_t state;
 	
     while (1)
 	{
-		if(LEFT_BUTTON)
-			ship.vel-= ;
-		if(RIGHT_BUTTON)
-			ship.vel++;
-		if(ACCEL_BUTTON)
-			ship.accel+=SHIP_ACCEL;
+		state = uButtonsWait(INPUT_RESYNC_MS / portTICK_RATE_MS);
+		
+		if(state & LEFT_BUTTON)
+			ship.a_vel = +SHIP_AVEL;
+		else if(state & RIGHT_BUTTON)
+			ship.a_vel = -SHIP_AVEL;
+		else
+			ship.a_vel = 0;
+			
+		if(state & ACCEL_BUTTON)
+			ship.accel = SHIP_ACCEL;
+		else
+			ship.accel = 0;
+		
+		if(state & SHOOT_BUTTON)
+		{
+			if(!shooting)
+			{
+				shooting = pdTRUE;
+				xSemaphoreGive(shootPressed);
+			}
+		}
+		else
+			shooting = pdFALSE;
 	}
 }
 
 /*------------------------------------------------------------------------------
  * Function: bulletTask
  *
- * Description: This task polls the state of the button that fires a bullet
- *  every 10 milliseconds. If a bullet is fired, this task blocks for half a
- *  second to regulate the fire rate.  If a bullet is not fired, the task
- *  blocks for a frame delay (FRAME_DELAY_MS)
+ * Description: This task blocks until the fire button is pressed. While it is
+ *  held, the task asks the simulation for a new bullet every half second.
  *
  * param vParam: This parameter is not used.
  *----------------------------------------------------------------------------*/
 void bulletTask(void *vParam) {
-	 /* Note:
-     * The ship heading is stored in ship.angle.
-     * The ship's position is stored in ship.pos.x and ship.pos.y
-     *
-     * You will need to use the following code to add a new bullet:
-     bullets = createBullet(x, y, vx, vy, bullets);
-     */
-	// variable to hold ticks value of last task run
-	portTickType xLastWakeTime;
-
-	// Initialize the xLastWakeTime variable with the current time.
-	xLastWakeTime = xTaskGetTickCount();
     while (1)
 	{
-		if(SHOOT_BUTTON)
+		xSemaphoreTake(shootPressed, portMAX_DELAY);
+		
+		while(shooting)
 		{
-			bullets = createBullet(ship.pos.x, ship.pos.y, ship.vel.x + BULLET_VEL, ship.vel.y + BULLET_VEL, bullets);
-						
-			vTaskDelay((BULLET_LIFE_MS/2)/portTICK_RATE_MS);
-		}
+			fireRequest = pdTRUE;
 			
-		vTaskDelayUntil(&xLastWakeTime, FRAME_DELAY_MS / portTICK_RATE_MS);
+			vTaskDelay(BULLET_DELAY_MS / portTICK_RATE_MS);
+		}
 	}
 }
 
 /*------------------------------------------------------------------------------
  * Function: updateTask
  *
- * Description: This task observes the currently stored velocities for every
- *  game object and updates their position and rotation accordingly. It also
- *  updates the ship's velocities based on its current acceleration and angle.
- *  If a bullet has been in flight for too long, this task will delete it. This
- *  task runs every 10 milliseconds.
+ * Description: This task runs the game simulation every 10 milliseconds. It
+ *  applies the ship's acceleration and every object's velocities, fires
+ *  requested bullets, expires old bullets, resolves collisions and ends the
+ *  game when it is won or lost. Hits are decided by the graphics module's
+ *  masks, as with uCollide, but only objects whose bounding circles touch are
+ *  tested there, and those tests are all in flight at once. Each test is a
+ *  COLLIDE round trip, which is counted for the draw task to report. At the
+ *  end of each step it publishes a render frame for the draw task. Sprites of
+ *  removed objects are handed to the draw task for deletion, so they are never
+ *  deleted while a frame that still shows them may be drawn.
  *
  * param vParam: This parameter is not used.
  *----------------------------------------------------------------------------*/
 void updateTask(void *vParam) {
-	float vel;
-	object *objIter, *objPrev;
+	portTickType xLastWakeTime;
+	int32_t vel;
+	xSpriteHandle hit;
+	point pos;
+	uint8_t i, j, q, size, queryCount, shipNear;
+	
+	xSemaphoreTake(usartMutex, portMAX_DELAY);
+	registerImages();
+	init();
+	publishFrame();
+	xSemaphoreGive(usartMutex);
+	
+	xLastWakeTime = xTaskGetTickCount();
 	for (;;) {
+		vTaskDelayUntil(&xLastWakeTime, FRAME_DELAY_MS / portTICK_RATE_MS);
+#if configUSE_TRACE_RECORDER == 1
+		vTraceMark(TRACE_MARK_UPDATE);
+#endif
+		frameSeq++;
 		
 		// spin ship
 		ship.angle += ship.a_vel;
@@ -199,206 +345,249 @@ void updateTask(void *vParam) {
 		    ship.angle += 360;
 		
 		// move ship
-		ship.vel.x += ship.accel * -sin(ship.angle * DEG_TO_RAD);
-		ship.vel.y += ship.accel * -cos(ship.angle * DEG_TO_RAD);
-		vel = ship.vel.x * ship.vel.x + ship.vel.y * ship.vel.y;
+		if (ship.accel != 0) {
+			ship.vel.x -= fxMulSin(ship.accel, fxSin(ship.angle));
+			ship.vel.y -= fxMulSin(ship.accel, fxCos(ship.angle));
+		}
+		vel = (int32_t)ship.vel.x * ship.vel.x + (int32_t)ship.vel.y * ship.vel.y;
 		if (vel > SHIP_MAX_VEL) {
-			ship.vel.x *= SHIP_MAX_VEL / vel;
-			ship.vel.y *= SHIP_MAX_VEL / vel;
+			ship.vel.x = (int16_t)((int32_t)ship.vel.x * SHIP_MAX_VEL / vel);
+			ship.vel.y = (int16_t)((int32_t)ship.vel.y * SHIP_MAX_VEL / vel);
 		}
 		
-		ship.pos.x += ship.vel.x;
-		ship.pos.y += ship.vel.y;
+		movePoint(&ship.pos, &ship.vel);
 		
-		if (ship.pos.x < 0.0) {
-			ship.pos.x += SCREEN_W;
-		} else if (ship.pos.x > SCREEN_W) {
-			ship.pos.x -= SCREEN_W;
-		}
-		
-		if (ship.pos.y < 0.0) {
-			ship.pos.y += SCREEN_H;
-		} else if (ship.pos.y > SCREEN_H) {
-			ship.pos.y -= SCREEN_H;
+		// fire
+		if (fireRequest) {
+			fireRequest = pdFALSE;
+			xSemaphoreTake(usartMutex, portMAX_DELAY);
+			createBullet(ship.pos.x, ship.pos.y,
+			             ship.vel.x - fxMulSin(BULLET_VEL, fxSin(ship.angle)),
+			             ship.vel.y - fxMulSin(BULLET_VEL, fxCos(ship.angle)));
+			xSemaphoreGive(usartMutex);
 		}
 		
 		// move bullets
-		objPrev = NULL;
-		objIter = bullets;
-		while (objIter != NULL) {
+		i = 0;
+		while (i < bullets.count) {
 			// Kill bullet after a while
-			objIter->life += FRAME_DELAY_MS;
-			if (objIter->life >= BULLET_LIFE_MS) {
-				
-				xSemaphoreTake(usartMutex, portMAX_DELAY);
-				vSpriteDelete(objIter->handle);
-				
-				if (objPrev != NULL) {
-					objPrev->next = objIter->next;
-					vPortFree(objIter);
-					objIter = objPrev->next;
-				} else {
-					bullets = objIter->next;
-					vPortFree(objIter);
-					objIter = bullets;
-				}
-				xSemaphoreGive(usartMutex);
+			if (++bullets.life[i] >= BULLET_LIFE_FRAMES) {
+				removeBullet(i);
 			} else {
-			    objIter->pos.x += objIter->vel.x;
-			    objIter->pos.y += objIter->vel.y;
-			
-			    if (objIter->pos.x < 0.0) {
-				    objIter->pos.x += SCREEN_W;
-			    } else if (objIter->pos.x > SCREEN_W) {
-				    objIter->pos.x -= SCREEN_W;
-			    }
+				movePoint(&bullets.pos[i], &bullets.vel[i]);
+				i++;
+			}
+		}
+		
+		// move asteroids
+		for (i = 0; i < asteroids.count; i++) {
+			movePoint(&asteroids.pos[i], &asteroids.vel[i]);
 			
-			    if (objIter->pos.y < 0.0) {
-				    objIter->pos.y += SCREEN_H;
-			    } else if (objIter->pos.y > SCREEN_H) {
-				    objIter->pos.y -= SCREEN_H;
-			    }
+			asteroids.angle[i] += asteroids.a_vel[i];
+			if (asteroids.angle[i] >= 360)
+			    asteroids.angle[i] -= 360;
+			else if (asteroids.angle[i] < 0)
+			    asteroids.angle[i] += 360;
+		}
+		
+		// the host's masks decide every hit, but only bodies whose bounding
+		// circles touch here are sent to the host to be tested
+		vCollisionClear();
+		for (i = 0; i < asteroids.count; i++) {
+			xCollisionInsert(asteroids.handle[i],
+			                 POS_TO_PIX(asteroids.pos[i].x),
+			                 POS_TO_PIX(asteroids.pos[i].y),
+			                 BOUNDING_RADIUS(sizeToPix(asteroids.size[i])));
+		}
+		
+		// highest slot first, so removing a bullet below only moves one
+		// which has already been handled
+		queryCount = 0;
+		for (i = bullets.count; i-- > 0; ) {
+			if (uCollisionQuery(POS_TO_PIX(bullets.pos[i].x),
+			                    POS_TO_PIX(bullets.pos[i].y),
+			                    BOUNDING_RADIUS(BULLET_SIZE), &hit, 1) > 0)
+			    queryBullets[queryCount++] = i;
+		}
+		shipNear = uCollisionQuery(POS_TO_PIX(ship.pos.x), POS_TO_PIX(ship.pos.y),
+		                           BOUNDING_RADIUS(SHIP_SIZE), &hit, 1) > 0;
+		
+		simulatedFrames++;
+		if (queryCount > 0 || shipNear) {
+			collideTrips += queryCount + shipNear;
+			collideFrames++;
+			xSemaphoreTake(usartMutex, portMAX_DELAY);
+			// the host tests the positions it was sent last, so send this step's,
+			// then issue every test before waiting on any reply
+			sendPositions();
+			for (q = 0; q < queryCount; q++) {
+				queries[q] = xCollideAsync(bullets.handle[queryBullets[q]], astGroup,
+				                           queryHits[q], MAX_QUERY_HITS);
+			}
+			if (shipNear)
+			    queries[q] = xCollideAsync(ship.handle, astGroup, queryHits[q], MAX_QUERY_HITS);
+			for (q = 0; q < queryCount + shipNear; q++) {
+				queryHitCounts[q] = uCollideAwait(queries[q]);
+			}
+			xSemaphoreGive(usartMutex);
 			
-			    objPrev = objIter;
-			    objIter = objIter->next;
-			}			
+			for (q = 0; q < queryCount; q++) {
+				j = findAsteroid(queryHits[q], queryHitCounts[q]);
+				if (j == NO_ASTEROID)
+				    continue;
+				
+				removeBullet(queryBullets[q]);
+				pos = asteroids.pos[j];
+				size = asteroids.size[j];
+				removeAsteroid(j);
+				
+				xSemaphoreTake(usartMutex, portMAX_DELAY);
+				spawnAsteroid(&pos, size);
+				xSemaphoreGive(usartMutex);
+			}
+		}
+				
+		if ((shipNear &&
+		     findAsteroid(queryHits[queryCount], queryHitCounts[queryCount]) != NO_ASTEROID) ||
+		    asteroids.count == 0) {
+			endGame();
+			xLastWakeTime = xTaskGetTickCount();
+			continue;
 		}
 		
-		// move asteroids
-        /* 
-         * ToDo: Add code to move the asteroids
-         */
+		publishFrame();
 		
-		vTaskDelay(FRAME_DELAY_MS / portTICK_RATE_MS);
+		if (xTaskGetTickCount() - xLastWakeTime >= FRAME_DELAY_MS / portTICK_RATE_MS)
+		    frameOverruns++;
 	}
 }
 
 /*------------------------------------------------------------------------------
  * Function: drawTask
  *
- * Description: This task sends the appropriate commands to update the game
- *  graphics every 10 milliseconds for a target frame rate of 100 FPS. It also
- *  checks collisions and performs the proper action based on the types of the
- *  colliding objects.
+ * Description: This task waits for the simulation to publish a render frame
+ *  and sends all of its transforms to the graphics module in one batch. After
+ *  each frame it deletes the sprites of objects which are in none of the
+ *  frames it may still draw. Every STATS_PERIOD_MS it also prints how many
+ *  COLLIDE round trips the simulation made, and sends the tasks' run times to
+ *  the host, when they are counted. A frame drawn late, or a frame skipped,
+ *  stops the trace recorder, keeping the events that led up to it, and the
+ *  trace is then sent.
  *
  * param vParam: This parameter is not used.
  *----------------------------------------------------------------------------*/
 void drawTask(void *vParam) {
-	object *objIter, *objPrev, *astIter, *astPrev, *objTemp;
-	xSpriteHandle hit, handle;
-	point pos;
-	uint8_t size;
-	
-	vTaskSuspend(updateTaskHandle);
-	vTaskSuspend(bulletTaskHandle);
-	vTaskSuspend(inputTaskHandle);
-	init();
-	vTaskResume(updateTaskHandle);
-	vTaskResume(bulletTaskHandle);
-	vTaskResume(inputTaskHandle);
+	renderFrame *frame;
+	renderItem *item;
+	deadSprite dead;
+	uint16_t drawnSeq = 0;
+	uint8_t i;
+	portTickType lastStats = xTaskGetTickCount();
+#if configUSE_TRACE_RECORDER == 1
+	portTickType traceSent = 0;
+	portBASE_TYPE traceWaiting = pdFALSE;
+#endif
 	
 	for (;;) {
+		xSemaphoreTake(frameReady, portMAX_DELAY);
 		xSemaphoreTake(usartMutex, portMAX_DELAY);
 		
-		vSpriteSetRotation(ship.handle, (uint16_t)ship.angle);
-		vSpriteSetPosition(ship.handle, (uint16_t)ship.pos.x, (uint16_t)ship.pos.y);
-
-		objPrev = NULL;
-		objIter = bullets;
-		while (objIter != NULL) {
-			vSpriteSetPosition(objIter->handle, (uint16_t)objIter->pos.x, (uint16_t)objIter->pos.y);
-			if (uCollide(objIter->handle, astGroup, &hit, 1) > 0) {
-				vSpriteDelete(objIter->handle);
-				
-				if (objPrev != NULL) {
-					objPrev->next = objIter->next;
-					vPortFree(objIter);
-					objIter = objPrev->next;
-				} else {
-					bullets = objIter->next;
-					vPortFree(objIter);
-					objIter = bullets;
-				}
-				astPrev = NULL;
-				astIter = asteroids;
-				while (astIter != NULL) {
-					if (astIter->handle == hit) {
-						pos = astIter->pos;
-						size = astIter->size;
-						vSpriteDelete(astIter->handle);
-						if (astPrev != NULL) {
-					        astPrev->next = astIter->next;
-					        vPortFree(astIter);
-					        astIter = astPrev->next;
-				        } else {
-					        asteroids = astIter->next;
-					        vPortFree(astIter);
-				        }
-						spawnAsteroid(&pos, size);
-						break;					
-						
-					} else {
-						astPrev = astIter;
-						astIter = astIter->next;
-					}
-				}
-				
-			} else {
-				objPrev = objIter;
-			    objIter = objIter->next;
-			}			
+		portENTER_CRITICAL();
+		reading = published;
+		portEXIT_CRITICAL();
+		
+		frame = &frames[reading];
+		if (frame->seq != drawnSeq) {
+			vFrameBegin();
+			for (i = 0, item = frame->items; i < frame->count; i++, item++) {
+				vSpriteBatchTransform(item->handle, item->x, item->y, item->angle);
+			}
+			vFrameEnd();
+#if configUSE_TRACE_RECORDER == 1
+			vTraceMark(TRACE_MARK_DRAW);
+#endif
+			// the deadline is the next frame being published
+			if ((drawnSeq != 0 && (uint16_t)(frame->seq - drawnSeq) > 1) ||
+			    xTaskGetTickCount() - frame->publishTick >= FRAME_DELAY_MS / portTICK_RATE_MS) {
+				framesLate++;
+#if configUSE_TRACE_RECORDER == 1
+				vTraceTrigger();
+#endif
+			}
+			drawnSeq = frame->seq;
 		}
 		
-		objIter = asteroids;
-		while (objIter != NULL) {
-			vSpriteSetPosition(objIter->handle, (uint16_t)objIter->pos.x, (uint16_t)objIter->pos.y);
-			vSpriteSetRotation(objIter->handle, objIter->angle);
-			objIter = objIter->next;
-		}			
-				
-		if (uCollide(ship.handle, astGroup, &hit, 1) > 0 || asteroids == NULL) {
-			vTaskSuspend(updateTaskHandle);
-			vTaskSuspend(bulletTaskHandle);
-			vTaskSuspend(inputTaskHandle);
-			
-			if (asteroids == NULL)
-			    handle = xSpriteCreate("win.png", SCREEN_W>>1, SCREEN_H>>1, 20, SCREEN_W>>1, SCREEN_H>>1, 100);
-			else
-			    handle = xSpriteCreate("lose.png", SCREEN_W>>1, SCREEN_H>>1, 0, SCREEN_W>>1, SCREEN_H>>1, 100);
-				
-			vTaskDelay(3000 / portTICK_RATE_MS);
-			vSpriteDelete(handle);
-			
-			reset();
-			init();
-			
-			vTaskResume(updateTaskHandle);
-			vTaskResume(bulletTaskHandle);
-			vTaskResume(inputTaskHandle);
+		reading = NO_FRAME;
+		
+		// later frames never show a sprite removed at or before this one
+		while (xQueuePeek(deadSprites, &dead, 0) == pdTRUE && (int16_t)(dead.seq - drawnSeq) <= 0) {
+			xQueueReceive(deadSprites, &dead, 0);
+			vSpriteDelete(dead.handle);
 		}
 		
-		xSemaphoreGive(usartMutex);
+		// while the link is held, so the report does not split a command
+		if (xTaskGetTickCount() - lastStats >= STATS_PERIOD_MS / portTICK_RATE_MS) {
+			lastStats = xTaskGetTickCount();
+			reportCollideTrips();
+#if configGENERATE_RUN_TIME_STATS == 1
+			vRunTimeStatsReport();
+#endif
+		}
+		
+#if configUSE_TRACE_RECORDER == 1
+		// the events leading up to a late frame, sent once recording has stopped
+		if (uTraceTriggered()) {
+			if (!traceWaiting) {
+				vTraceReport();
+				traceSent = xTaskGetTickCount();
+				traceWaiting = pdTRUE;
+			} else if (xTaskGetTickCount() - traceSent >= TRACE_HOLDOFF_MS / portTICK_RATE_MS) {
+				vTraceStart();
+				traceWaiting = pdFALSE;
+			}
+		}
+#endif
 		
-		vTaskDelay(FRAME_DELAY_MS / portTICK_RATE_MS);
+		xSemaphoreGive(usartMutex);
 	}
 }
 
 int main(void) {
-	DDRB = 0x00;
 	TCCR2A = _BV(CS00); 
 	
+#if configUSE_TRACE_RECORDER == 1
+	vTraceInit();
+#endif
 	usartMutex = xSemaphoreCreateMutex();
+	vSemaphoreCreateBinary(frameReady);
+	xSemaphoreTake(frameReady, 0);
+	vSemaphoreCreateBinary(shootPressed);
+	xSemaphoreTake(shootPressed, 0);
+	vButtonsInit(ALL_BUTTONS);
+	deadSprites = xQueueCreate(DEAD_SPRITE_QUEUE_LENGTH, sizeof(deadSprite));
+#if configUSE_TRACE_RECORDER == 1
+	vTraceNameQueue(usartMutex, "usart");
+	vTraceNameQueue(frameReady, "frameReady");
+	vTraceNameQueue(shootPressed, "shootPressed");
+	vTraceNameQueue(deadSprites, "deadSprites");
+#endif
 	
 	vWindowCreate(SCREEN_W, SCREEN_H);
 	
 	sei();
 	
-	xTaskCreate(inputTask, (signed char *) "i", 80, NULL, 1, &inputTaskHandle);
-	xTaskCreate(bulletTask, (signed char *) "b", 130, NULL, 2, &bulletTaskHandle);
-	xTaskCreate(updateTask, (signed char *) "u", 200, NULL, 4, &updateTaskHandle);
+#if configRUN_KERNEL_BENCHMARK == 1
+	vBenchmarkStart();
+#else
+	xTaskCreate(inputTask, (signed char *) "i", 80, NULL, 1, NULL);
+	xTaskCreate(bulletTask, (signed char *) "b", 130, NULL, 2, NULL);
+	xTaskCreate(updateTask, (signed char *) "u", 200, NULL, 4, NULL);
 	xTaskCreate(drawTask, (signed char *) "d", 230, NULL, 3, NULL);
-	xTaskCreate(USART_Write_Task, (signed char *) "w", 150, NULL, 5, NULL);
+#endif
 	
+#if configUSE_TRACE_RECORDER == 1
+	vTraceStart();
+#endif
 	vTaskStartScheduler();
 	
 	for (;;)
@@ -406,6 +595,22 @@ int main(void) {
 	return 0;
 }
 
+/*------------------------------------------------------------------------------
+ * Function: registerImages
+ *
+ * Description: This function registers the images of the sprites created
+ *  during a game, so creating them sends a one-byte id instead of a filename.
+ *  A window must be created before this function may be called.
+ *----------------------------------------------------------------------------*/
+void registerImages(void) {
+	uint8_t i;
+	
+	for (i = 0; i < 3; i++) {
+		astImageIds[i] = xImageRegister(astImages[i]);
+	}
+	bulletImage = xImageRegister("bullet.png");
+}
+
 /*------------------------------------------------------------------------------
  * Function: init
  *
@@ -415,8 +620,9 @@ int main(void) {
 void init(void) {
 	int i;
 	
-	bullets = NULL;
-	asteroids = NULL;
+	bullets.count = 0;
+	asteroids.count = 0;
+	fireRequest = pdFALSE;
 	astGroup = ERROR_HANDLE;
 	
 	background = xSpriteCreate("stars.png", SCREEN_W>>1, SCREEN_H>>1, 0, SCREEN_W, SCREEN_H, 0);
@@ -426,19 +632,19 @@ void init(void) {
 	astGroup = xGroupCreate();
 	
 	for (i = 0; i < INITIAL_ASTEROIDS; i++) {
-		asteroids = createAsteroid(getRandStartPosVal(SCREEN_W >> 1),
-		                           getRandStartPosVal(SCREEN_H >> 1),
-		                           (rand() % (int8_t)(AST_MAX_VEL_3 * 10)) / 5.0 - AST_MAX_VEL_3,
-								   (rand() % (int8_t)(AST_MAX_VEL_3 * 10)) / 5.0 - AST_MAX_VEL_3,
-								   rand() % 360,
-								   (rand() % (int8_t)(AST_MAX_AVEL_3 * 10)) / 5.0 - AST_MAX_AVEL_3,
-								   3,
-								   asteroids);
+		createAsteroid(PIX_TO_POS(getRandStartPosVal(SCREEN_W >> 1)),
+		               PIX_TO_POS(getRandStartPosVal(SCREEN_H >> 1)),
+		               getRandVel(AST_MAX_VEL_3),
+		               getRandVel(AST_MAX_VEL_3),
+		               rand() % 360,
+		               rand() % (2 * AST_MAX_AVEL_3) - AST_MAX_AVEL_3,
+		               3);
 	}
+	createAsteroidSprites(0);
 	
 	ship.handle = xSpriteCreate("ship.png", SCREEN_W >> 1, SCREEN_H >> 1, 0, SHIP_SIZE, SHIP_SIZE, 1);
-	ship.pos.x = SCREEN_W >> 1;
-	ship.pos.y = SCREEN_H >> 1;
+	ship.pos.x = PIX_TO_POS(SCREEN_W >> 1);
+	ship.pos.y = PIX_TO_POS(SCREEN_H >> 1);
 	ship.vel.x = 0;
 	ship.vel.y = 0;
 	ship.accel = 0;
@@ -449,25 +655,208 @@ void init(void) {
 /*------------------------------------------------------------------------------
  * Function: reset
  *
- * Description: This function destroys all game objects in the heap and clears
- *  their respective sprites from the window.
+ * Description: This function destroys all game objects and clears their
+ *  respective sprites from the window. Every sprite is in ALL_GROUP, including
+ *  retired ones the draw task has not deleted yet, so one message clears them.
  *----------------------------------------------------------------------------*/
 void reset(void) {
-	/* Note:
-     * You need to free all resources here using a reentrant function provided by
-     * the freeRTOS API and clear all sprites from the game window.
-     * Use vGroupDelete for the asteroid group.
-     *
-     * Remember bullets and asteroids are object lists so you should traverse the list
-     * using something like:  
-     *	while (thisObject != NULL) {
-     *		vSpriteDelete(thisObject)
-     *		nextObject = thisObject->next.
-     *		delete thisObject using a reentrant function
-     *		thisObject = nextObject
-     *	}
-     */
-	 
+	uGroupClear(ALL_GROUP);
+	asteroids.count = 0;
+	bullets.count = 0;
+	vGroupDelete(astGroup);
+}
+
+/*------------------------------------------------------------------------------
+ * Function: endGame
+ *
+ * Description: This function shows the win or lose message for three seconds
+ *  and starts a new game. The draw task is kept off the graphics link for the
+ *  whole time, and the first frame of the new game is published before it may
+ *  draw again. Sprites waiting to be deleted are left for reset to clear.
+ *----------------------------------------------------------------------------*/
+void endGame(void) {
+	deadSprite dead;
+	
+	xSemaphoreTake(usartMutex, portMAX_DELAY);
+	
+	while (xQueueReceive(deadSprites, &dead, 0) == pdTRUE)
+	    ;
+	
+	if (asteroids.count == 0)
+	    xSpriteCreate("win.png", SCREEN_W>>1, SCREEN_H>>1, 20, SCREEN_W>>1, SCREEN_H>>1, 100);
+	else
+	    xSpriteCreate("lose.png", SCREEN_W>>1, SCREEN_H>>1, 0, SCREEN_W>>1, SCREEN_H>>1, 100);
+		
+	vTaskDelay(3000 / portTICK_RATE_MS);
+	
+	reset();
+	init();
+	publishFrame();
+	
+	xSemaphoreGive(usartMutex);
+}
+
+/*------------------------------------------------------------------------------
+ * Function: publishFrame
+ *
+ * Description: This function copies the current position and rotation of every
+ *  game object into the render frame the draw task is not using and publishes
+ *  it. If the draw task is still reading the older frame, nothing is published
+ *  this step and the draw task will pick up the next one.
+ *----------------------------------------------------------------------------*/
+void publishFrame(void) {
+	uint8_t back = published ^ 1;
+	renderFrame *frame;
+	renderItem *item;
+	uint8_t i;
+	
+	// the draw task never runs while this higher priority task does
+	if (reading == back)
+	    return;
+	
+	frame = &frames[back];
+	item = frame->items;
+	
+	item->handle = ship.handle;
+	item->x = POS_TO_PIX(ship.pos.x);
+	item->y = POS_TO_PIX(ship.pos.y);
+	item->angle = (uint16_t)ship.angle;
+	item++;
+	
+	for (i = 0; i < bullets.count; i++, item++) {
+		item->handle = bullets.handle[i];
+		item->x = POS_TO_PIX(bullets.pos[i].x);
+		item->y = POS_TO_PIX(bullets.pos[i].y);
+		item->angle = (uint16_t)bullets.angle[i];
+	}
+	
+	for (i = 0; i < asteroids.count; i++, item++) {
+		item->handle = asteroids.handle[i];
+		item->x = POS_TO_PIX(asteroids.pos[i].x);
+		item->y = POS_TO_PIX(asteroids.pos[i].y);
+		item->angle = (uint16_t)asteroids.angle[i];
+	}
+	
+	frame->count = item - frame->items;
+	frame->seq = frameSeq;
+	frame->publishTick = xTaskGetTickCount();
+	published = back;
+	
+	xSemaphoreGive(frameReady);
+}
+
+/*------------------------------------------------------------------------------
+ * Function: sendPositions
+ *
+ * Description: This function sends the current position and rotation of every
+ *  game object to the graphics module as one frame, so that collision tests
+ *  which follow it see this simulation step. The caller holds usartMutex.
+ *----------------------------------------------------------------------------*/
+void sendPositions(void) {
+	uint8_t i;
+	
+	vFrameBegin();
+	vSpriteBatchTransform(ship.handle, POS_TO_PIX(ship.pos.x), POS_TO_PIX(ship.pos.y),
+	                      (uint16_t)ship.angle);
+	for (i = 0; i < bullets.count; i++) {
+		vSpriteBatchTransform(bullets.handle[i], POS_TO_PIX(bullets.pos[i].x),
+		                      POS_TO_PIX(bullets.pos[i].y), (uint16_t)bullets.angle[i]);
+	}
+	for (i = 0; i < asteroids.count; i++) {
+		vSpriteBatchTransform(asteroids.handle[i], POS_TO_PIX(asteroids.pos[i].x),
+		                      POS_TO_PIX(asteroids.pos[i].y), (uint16_t)asteroids.angle[i]);
+	}
+	vFrameEnd();
+}
+
+/*------------------------------------------------------------------------------
+ * Function: findAsteroid
+ *
+ * Description: This function finds the first hit reported by the host which is
+ *  a live asteroid, skipping ones destroyed earlier whose sprites the draw task
+ *  has not deleted yet.
+ *
+ * param hits: The hits stored by uCollideAwait.
+ * param hitCount: The count returned by uCollideAwait.
+ * return: The asteroid's slot, or NO_ASTEROID.
+ *----------------------------------------------------------------------------*/
+uint8_t findAsteroid(xSpriteHandle hits[], uint8_t hitCount) {
+	uint8_t i, j;
+	
+	if (hitCount > MAX_QUERY_HITS)
+	    hitCount = MAX_QUERY_HITS;
+	
+	for (i = 0; i < hitCount; i++) {
+		for (j = 0; j < asteroids.count; j++) {
+			if (asteroids.handle[j] == hits[i])
+			    return j;
+		}
+	}
+	return NO_ASTEROID;
+}
+
+/*------------------------------------------------------------------------------
+ * Function: reportCollideTrips
+ *
+ * Description: This function prints the COLLIDE round trips made since the
+ *  last stats period, per frame simulated, and how many of those frames made
+ *  any, then starts counting again. The caller holds usartMutex.
+ *----------------------------------------------------------------------------*/
+void reportCollideTrips(void) {
+	static char line[STATS_LINE_LENGTH];
+	uint16_t trips, tripFrames, frames;
+	
+	portENTER_CRITICAL();
+	trips = collideTrips;
+	tripFrames = collideFrames;
+	frames = simulatedFrames;
+	collideTrips = 0;
+	collideFrames = 0;
+	simulatedFrames = 0;
+	portEXIT_CRITICAL();
+	
+	if (frames == 0)
+	    return;
+	trips = (uint16_t)((uint32_t)trips * 100 / frames);
+	sprintf(line, "collide: %u.%02u trips/frame, %u of %u frames",
+	        trips / 100, trips % 100, tripFrames, frames);
+	vPrint(line);
+}
+
+/*------------------------------------------------------------------------------
+ * Function: retireSprite
+ *
+ * Description: This function hands the sprite of an object removed during the
+ *  current simulation step to the draw task, which deletes it once a frame
+ *  without the object has been drawn. If the draw task has fallen so far
+ *  behind that the queue is full, the sprite is deleted here instead, while
+ *  the link is held so no frame is being drawn, and taken out of the frame
+ *  the draw task will draw next.
+ *
+ * param handle: The sprite to delete.
+ *----------------------------------------------------------------------------*/
+void retireSprite(xSpriteHandle handle) {
+	deadSprite dead;
+	renderFrame *frame;
+	uint8_t i;
+	
+	dead.handle = handle;
+	dead.seq = frameSeq;
+	// never waits: the draw task only empties the queue after drawing a
+	// frame, and no frame is published while this task is blocked
+	if (xQueueSend(deadSprites, &dead, 0) == pdTRUE)
+	    return;
+	
+	xSemaphoreTake(usartMutex, portMAX_DELAY);
+	vSpriteDelete(handle);
+	frame = &frames[published];
+	for (i = 0; i < frame->count; i++) {
+		if (frame->items[i].handle == handle) {
+			frame->items[i] = frame->items[--frame->count];
+			break;
+		}
+	}
+	xSemaphoreGive(usartMutex);
 }
 
 /*------------------------------------------------------------------------------
@@ -484,33 +873,131 @@ int16_t getRandStartPosVal(int16_t dimOver2) {
 	return rand() % (dimOver2 - DEAD_ZONE_OVER_2) + (rand() % 2) * (dimOver2 + DEAD_ZONE_OVER_2);
 }
 
+/*------------------------------------------------------------------------------
+ * Function: getRandVel
+ *
+ * Description: This function picks a random velocity component for a new
+ *  asteroid.
+ *
+ * param maxVel: The largest speed allowed, in Q8.8 pixels per frame.
+ * return: A pseudorandom velocity in the range [-maxVel, maxVel) in Q8.8.
+ *----------------------------------------------------------------------------*/
+int16_t getRandVel(int16_t maxVel) {
+	return rand() % (2 * maxVel) - maxVel;
+}
+
+/*------------------------------------------------------------------------------
+ * Function: movePoint
+ *
+ * Description: This function advances a position by one frame of velocity and
+ *  wraps it around the edges of the window.
+ *
+ * param pos: A pointer to the position to move, in Q12.4 window coordinates.
+ * param vel: A pointer to the velocity to move by, in Q8.8 pixels per frame.
+ *----------------------------------------------------------------------------*/
+void movePoint(point *pos, point *vel) {
+	pos->x += VEL_TO_POS(vel->x);
+	pos->y += VEL_TO_POS(vel->y);
+	
+	if (pos->x < 0) {
+		pos->x += SCREEN_W_POS;
+	} else if (pos->x > SCREEN_W_POS) {
+		pos->x -= SCREEN_W_POS;
+	}
+	
+	if (pos->y < 0) {
+		pos->y += SCREEN_H_POS;
+	} else if (pos->y > SCREEN_H_POS) {
+		pos->y -= SCREEN_H_POS;
+	}
+}
+
 /*------------------------------------------------------------------------------
  * Function: createAsteroid
  *
- * Description: This function creates a new asteroid object with a random
- *  sprite image.
+ * Description: This function adds a new asteroid to the end of the asteroid
+ *  store. Its sprite is created later by createAsteroidSprites.
  *
- * param x: The starting x position of the asteroid in window coordinates.
- * param y: The starting y position of the asteroid in window coordinates.
- * param velx: The starting x velocity of the asteroid in pixels per frame.
- * param vely: The starting y velocity of the asteroid in pixels per frame.
+ * param x: The starting x position of the asteroid in Q12.4 window coordinates.
+ * param y: The starting y position of the asteroid in Q12.4 window coordinates.
+ * param velx: The starting x velocity of the asteroid in Q8.8 pixels per frame.
+ * param vely: The starting y velocity of the asteroid in Q8.8 pixels per frame.
  * param angle: The starting angle of the asteroid in degrees.
  * param avel: The starting angular velocity of the asteroid in degrees per
  *  frame.
  * param size: The starting size of the asteroid. Must be in the range [1,3].
- * param nxt: A pointer to the next asteroid object in a linked list.
- * return: A pointer to a malloc'd asteroid object. Must be freed by the calling
- *  process.
+ *  The asteroid is dropped if MAX_ASTEROIDS already exist.
  *----------------------------------------------------------------------------*/
-object *createAsteroid(float x, float y, float velx, float vely, int16_t angle, int8_t avel, int8_t size, object *nxt) {
-	/* ToDo:
-     * Create a new asteroid object using a reentrant malloc() function
-     * Setup the pointers in the linked list using:
-     asteroid->next = nxt;
-     * Create a new sprite using xSpriteCreate()
-     * Add new asteroid to the group "astGroup" using:
-     *	vGroupAddSprite() 
-     */
+void createAsteroid(int16_t x, int16_t y, int16_t velx, int16_t vely, int16_t angle, int8_t avel, int8_t size) {
+	uint8_t i = asteroids.count;
+	
+	if (i == MAX_ASTEROIDS)
+	    return;
+	
+	asteroids.handle[i] = ERROR_HANDLE;
+	asteroids.pos[i].x = x;
+	asteroids.pos[i].y = y;
+	asteroids.vel[i].x = velx;
+	asteroids.vel[i].y = vely;
+	asteroids.angle[i] = angle;
+	asteroids.a_vel[i] = avel;
+	asteroids.size[i] = size;
+	asteroids.count = i + 1;
+}
+
+/*------------------------------------------------------------------------------
+ * Function: createAsteroidSprites
+ *
+ * Description: This function creates sprites with random images for the
+ *  asteroids added since the given slot and puts them in the asteroid group,
+ *  MAX_SPAWN asteroids to a message.
+ *
+ * param first: The slot of the first asteroid without a sprite.
+ *----------------------------------------------------------------------------*/
+void createAsteroidSprites(uint8_t first) {
+	xSpriteSpec *spec;
+	uint8_t i, n;
+	
+	while (first < asteroids.count) {
+		n = asteroids.count - first;
+		if (n > MAX_SPAWN)
+		    n = MAX_SPAWN;
+		
+		for (i = 0; i < n; i++) {
+			spec = &astSpawns[i];
+			spec->image = astImageIds[rand() % 3];
+			spec->x = POS_TO_PIX(asteroids.pos[first + i].x);
+			spec->y = POS_TO_PIX(asteroids.pos[first + i].y);
+			spec->angle = asteroids.angle[first + i];
+			spec->width = sizeToPix(asteroids.size[first + i]);
+			spec->height = spec->width;
+			spec->depth = 1;
+		}
+		uSpriteCreateBatch(astGroup, astSpawns, n, &asteroids.handle[first]);
+		first += n;
+	}
+}
+
+/*------------------------------------------------------------------------------
+ * Function: removeAsteroid
+ *
+ * Description: This function retires an asteroid's sprite and fills its slot
+ *  with the last asteroid in the store.
+ *
+ * param index: The slot of the asteroid to remove.
+ *----------------------------------------------------------------------------*/
+void removeAsteroid(uint8_t index) {
+	uint8_t last = asteroids.count - 1;
+	
+	retireSprite(asteroids.handle[index]);
+	
+	asteroids.handle[index] = asteroids.handle[last];
+	asteroids.pos[index] = asteroids.pos[last];
+	asteroids.vel[index] = asteroids.vel[last];
+	asteroids.angle[index] = asteroids.angle[last];
+	asteroids.a_vel[index] = asteroids.a_vel[last];
+	asteroids.size[index] = asteroids.size[last];
+	asteroids.count = last;
 }
 
 /*------------------------------------------------------------------------------
@@ -540,51 +1027,88 @@ uint16_t sizeToPix(int8_t size) {
 /*------------------------------------------------------------------------------
  * Function: createBullet
  *
- * Description: This function creates a new bullet object.
+ * Description: This function adds a new bullet to the end of the bullet
+ *  store.
  *
- * param x: The starting x position of the new bullet sprite.
- * param y: The starting y position of the new bullet sprite.
- * param velx: The new bullet's x velocity.
- * param vely: The new bullet's y velocity.
- * param nxt: A pointer to the next bullet object in a linked list of bullets.
- * return: A pointer to a malloc'd bullet object. This pointer must be freed by
- *  the caller.
+ * param x: The starting x position of the new bullet sprite in Q12.4.
+ * param y: The starting y position of the new bullet sprite in Q12.4.
+ * param velx: The new bullet's x velocity in Q8.8.
+ * param vely: The new bullet's y velocity in Q8.8. The bullet is dropped if
+ *  MAX_BULLETS already exist.
  *----------------------------------------------------------------------------*/
-object *createBullet(float x, float y, float velx, float vely, object *nxt) 
-{
-	/* ToDo:
-     * Create a new bullet object using a reentrant malloc() function
-     * Setup the pointers in the linked list using:
-     bullet->next = nxt;
-     * Create a new sprite using xSpriteCreate()
-     */
-	 
-	 if(pvPortMalloc(sizeof(object)) != NULL)
-	 {
-		bullet.pos.x = x;
-		bullet.pos.y = y;
-		bullet.vel.x = velx;
-		bullet.vel.y = vely;
-		bullet -> next = nxt;
-		
-		xSpriteCreate("bullet.png",(uint16_t)bullet.pos.x ,(uint16_t)bullet.pos.y, 0, BULLET_SIZE, BULLET_SIZE, 1);
-	 }
+void createBullet(int16_t x, int16_t y, int16_t velx, int16_t vely) {
+	uint8_t i = bullets.count;
+	
+	if (i == MAX_BULLETS)
+	    return;
+	
+	bullets.handle[i] = xSpriteCreateById(bulletImage, POS_TO_PIX(x), POS_TO_PIX(y), ship.angle, BULLET_SIZE, BULLET_SIZE, 1);
+	bullets.pos[i].x = x;
+	bullets.pos[i].y = y;
+	bullets.vel[i].x = velx;
+	bullets.vel[i].y = vely;
+	bullets.angle[i] = ship.angle;
+	bullets.life[i] = 0;
+	bullets.count = i + 1;
+}
+
+/*------------------------------------------------------------------------------
+ * Function: removeBullet
+ *
+ * Description: This function retires a bullet's sprite and fills its slot with
+ *  the last bullet in the store.
+ *
+ * param index: The slot of the bullet to remove.
+ *----------------------------------------------------------------------------*/
+void removeBullet(uint8_t index) {
+	uint8_t last = bullets.count - 1;
+	
+	retireSprite(bullets.handle[index]);
+	
+	bullets.handle[index] = bullets.handle[last];
+	bullets.pos[index] = bullets.pos[last];
+	bullets.vel[index] = bullets.vel[last];
+	bullets.angle[index] = bullets.angle[last];
+	bullets.life[index] = bullets.life[last];
+	bullets.count = last;
 }
 
 /*------------------------------------------------------------------------------
  * Function: spawnAsteroid
  *
  * Description: This function decomposes a larger asteroid into three smaller
- *  ones with random velocities and appends them to the global list of
- *  asteroids.
+ *  ones with random velocities and appends them to the asteroid store.
  *
  * param pos: A pointer to the position at which the new asteroids will be
  *  created.
  * param size: The size of the asteroid being destroyed.
  *----------------------------------------------------------------------------*/
 void spawnAsteroid(point *pos, uint8_t size) {
-	/* ToDo:
-     * Spawn 3 smaller asteroids, or no asteroids depending on the size of this asteroid
-     * Use createAsteroid()
-     */
+	int16_t vel;
+	int8_t avel;
+	uint8_t i, first = asteroids.count;
+	
+	switch (size - 1) {
+		case 2:
+		    vel = AST_MAX_VEL_2;
+		    avel = AST_MAX_AVEL_2;
+		    break;
+		case 1:
+		    vel = AST_MAX_VEL_1;
+		    avel = AST_MAX_AVEL_1;
+		    break;
+		default:
+		    return;
+	}
+	
+	for (i = 0; i < 3; i++) {
+		createAsteroid(pos->x,
+		               pos->y,
+		               getRandVel(vel),
+		               getRandVel(vel),
+		               rand() % 360,
+		               rand() % (2 * avel) - avel,
+		               size - 1);
+	}
+	createAsteroidSprites(first);
 }
@@ -0,0 +1,792 @@
+/*******************************************************************************
+* File: benchmark.c
+*
+* Description: Microbenchmarks of the kernel's signalling paths, counted in CPU
+*  cycles. They are built in place of the game when configRUN_KERNEL_BENCHMARK
+*  is 1, and print their results on the host with vPrint. Timer5 is already
+*  the microsecond clock at clk/64, four cycles a count too coarse for these,
+*  so Timer4, which nothing else uses, counts every cycle. It wraps every
+*  65536 cycles, 4ms at 16MHz, which is far longer than any kernel path timed
+*  here; a simulation step may take longer, so prvTimeStep counts one wrap.
+*  Each result is the fewest, mean and most cycles over BENCH_RUNS runs, less
+*  the cost of reading the counter twice. The tick interrupt lands in some
+*  runs, which shows in the mean and most but not in the fewest. Run time
+*  stats and the trace recorder add to every switch, so the configuration is
+*  printed with the results, along with how the scheduler picks the next task:
+*  the ready-priority bitmap when configUSE_PORT_OPTIMISED_TASK_SELECTION is
+*  1, or a scan down the ready lists when it is 0. The switches timed here
+*  are from the highest priority down to the lowest, past every empty list,
+*  and between two tasks at the lowest. Building with each setting compares
+*  the two. One step of the game's simulation is timed as well, with 5, 50
+*  and 150 objects, in fixed and in floating point, and so is handing one
+*  SET_POS to the link, through the transmit ring and a byte at a time
+*  through a queue, as USART_Write_Task was fed.
+*
+*******************************************************************************/
+#include <avr/io.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+#include "benchmark.h"
+#include "collision.h"
+#include "fixed.h"
+#include "graphics.h"
+#include "usart.h"
+
+#if configRUN_KERNEL_BENCHMARK == 1
+
+#define BENCH_RUNS          200
+#define BENCH_LINE          (PRINT_MAX_LENGTH + 1)
+#define RUNNER_STACK        300
+#define WAITER_STACK        120
+#define RUNNER_PRIORITY     1
+#define WAITER_PRIORITY     (configMAX_PRIORITIES - 1)
+
+/* ulNotifiedValue and ucNotifyState, which every TCB has whether or not the
+ * task is ever notified. */
+#define NOTIFY_TCB_BYTES    5
+
+/* The simulation step is timed with this many objects, a tenth of them
+ * bullets, as well as the ship. */
+#define STEP_MAX_OBJECTS    150
+#define STEP_RUNS           50
+#define STEP_BULLETS(n)     (((n) + 9) / 10)
+
+/* As in asteroids.c */
+#define SCREEN_W            800
+#define SCREEN_H            600
+#define SCREEN_W_POS        PIX_TO_POS(SCREEN_W)
+#define SCREEN_H_POS        PIX_TO_POS(SCREEN_H)
+#define SHIP_SIZE           24
+#define BULLET_SIZE         6
+#define BULLET_VEL          VEL_CONST(6.0)
+#define BULLET_LIFE_FRAMES  100
+#define SHIP_ACCEL          VEL_CONST(0.1)
+#define AST_MAX_VEL         VEL_CONST(4.0)
+#define AST_MAX_AVEL        9
+#define BOUNDING_RADIUS(size) ((uint8_t)(((size) * 182 + 255) >> 8))
+#define DEG_TO_RAD          (M_PI / 180.0)
+
+/* As in graphics.c */
+#define SET_POS             0x02
+
+/* The queue USART_Write_Task drained held this many bytes. */
+#define WRITE_QUEUE_LENGTH  150
+/* 128 bytes, a full transmit ring, take 33ms to send at 38400 baud, and one
+ * SET_POS under 2ms, so the ring is empty when each run starts. */
+#define WRITE_DRAIN_TICKS   40
+#define WRITE_SETTLE_TICKS  2
+
+/* One count per CPU cycle. */
+#define CYCLES()            TCNT4
+#define CYCLES_SINCE(start) ((uint16_t)(CYCLES() - (start)))
+
+/* The simulation's bodies, stored as structures of arrays as asteroids.c
+ * stores them: asteroids first, then bullets. */
+typedef struct {
+	int16_t x;
+	int16_t y;
+} xPoint;
+
+typedef struct {
+	xPoint pos[STEP_MAX_OBJECTS];
+	xPoint vel[STEP_MAX_OBJECTS];
+	int16_t angle[STEP_MAX_OBJECTS];
+	int8_t aVel[STEP_MAX_OBJECTS];
+	uint8_t size[STEP_MAX_OBJECTS];
+	uint8_t life[STEP_MAX_OBJECTS];
+} xStepStore;
+
+/* The same bodies in floating point, as updateTask kept them before the
+ * fixed-point physics. */
+typedef struct {
+	float x;
+	float y;
+} xFloatPoint;
+
+typedef struct {
+	xFloatPoint pos[STEP_MAX_OBJECTS];
+	xFloatPoint vel[STEP_MAX_OBJECTS];
+	int16_t angle[STEP_MAX_OBJECTS];
+	int8_t aVel[STEP_MAX_OBJECTS];
+	uint8_t size[STEP_MAX_OBJECTS];
+} xFloatStepStore;
+
+typedef union {
+	xStepStore fixed;
+	xFloatStepStore floating;
+} xStepStorage;
+
+typedef struct {
+	uint32_t fewest;
+	uint32_t most;
+	uint32_t total;
+	uint16_t runs;
+} xCycleStats;
+
+static xSemaphoreHandle semaphore;
+static size_t semaphoreBytes;
+static xTaskHandle runner;
+static xTaskHandle notifyWaiter;
+static xTaskHandle partner;
+static volatile uint16_t started;
+static volatile uint16_t blocked;
+static volatile portBASE_TYPE yielding;
+static uint16_t overhead;
+static xCycleStats stats;
+static xCycleStats wakeStats;
+static char line[BENCH_LINE];
+static xStepStore *store;
+static xFloatStepStore *floatStore;
+static xPoint shipPos, shipVel;
+static xFloatPoint shipFloatPos, shipFloatVel;
+static int16_t shipAngle;
+static volatile uint8_t stepNear;
+static xQueueHandle writeQueue;
+
+static void prvStatsReset(xCycleStats *s);
+static void prvStatsAdd(xCycleStats *s, uint32_t cycles);
+static void prvStatsReport(const char *name, const xCycleStats *s);
+static void prvRunnerTask(void *params);
+static void prvSemaphoreWaiterTask(void *params);
+static void prvNotifyWaiterTask(void *params);
+static void prvPartnerTask(void *params);
+static void prvStepBenchmarks(void);
+static void prvWriteBenchmarks(void);
+static void prvWriteTask(void *params);
+static uint32_t prvTimeStep(void (*step)(uint8_t, uint8_t), uint8_t asteroidCount,
+ uint8_t bulletCount);
+static void prvStepFill(uint8_t asteroidCount, uint8_t bulletCount);
+static void prvStep(uint8_t asteroidCount, uint8_t bulletCount);
+static void prvFloatStep(uint8_t asteroidCount, uint8_t bulletCount);
+static void prvMovePoint(xPoint *pos, const xPoint *vel);
+static uint8_t prvSizeToPix(uint8_t size);
+
+/*******************************************************************************
+* Function: vBenchmarkStart
+*
+* Description: Starts Timer4 counting CPU cycles, creates the semaphore the
+*  benchmarks give, weighing it on the heap, and creates the runner.
+*******************************************************************************/
+void vBenchmarkStart(void) {
+	size_t freeBytes;
+
+	TCCR4A = 0;
+	TCCR4B = _BV(CS40);
+
+	freeBytes = xPortGetFreeHeapSize();
+	vSemaphoreCreateBinary(semaphore);
+	semaphoreBytes = freeBytes - xPortGetFreeHeapSize();
+	xSemaphoreTake(semaphore, 0);
+
+	xTaskCreate(prvRunnerTask, (signed char *) "r", RUNNER_STACK, NULL,
+	 RUNNER_PRIORITY, &runner);
+}
+
+/*******************************************************************************
+* Function: prvStatsReset
+*
+* Description: Empties a benchmark's statistics.
+*******************************************************************************/
+static void prvStatsReset(xCycleStats *s) {
+	s->fewest = 0xFFFFFFFFUL;
+	s->most = 0;
+	s->total = 0;
+	s->runs = 0;
+}
+
+/*******************************************************************************
+* Function: prvStatsAdd
+*
+* Description: Adds one run, less the cost of reading the counter.
+*******************************************************************************/
+static void prvStatsAdd(xCycleStats *s, uint32_t cycles) {
+	cycles = cycles > overhead ? cycles - overhead : 0;
+	if (cycles < s->fewest) {
+		s->fewest = cycles;
+	}
+	if (cycles > s->most) {
+		s->most = cycles;
+	}
+	s->total += cycles;
+	s->runs++;
+}
+
+/*******************************************************************************
+* Function: prvStatsReport
+*
+* Description: Prints the fewest, mean and most cycles of a benchmark.
+*******************************************************************************/
+static void prvStatsReport(const char *name, const xCycleStats *s) {
+	sprintf(line, "%-24s %6lu %6lu %6lu", name, (unsigned long)s->fewest,
+	 s->runs ? (unsigned long)(s->total / s->runs) : 0UL,
+	 (unsigned long)s->most);
+	vPrint(line);
+}
+
+/*******************************************************************************
+* Function: prvRunnerTask
+*
+* Description: Runs each benchmark BENCH_RUNS times and prints its results,
+*  then suspends itself. The FromISR calls are made with interrupts disabled,
+*  as they would be in an interrupt handler, and a wake is followed by the
+*  yield the handler would end with. The waiters are only created for the
+*  wake benchmarks, so that nothing waits on the semaphore before then. They
+*  run at the highest priority, so each runs at once and blocks.
+*******************************************************************************/
+static void prvRunnerTask(void *params) {
+	uint16_t run, start, end;
+	portBASE_TYPE woken;
+
+	/* The cost of reading the counter twice, taken off every result. */
+	overhead = 0xFFFF;
+	for (run = 0; run < BENCH_RUNS; run++) {
+		start = CYCLES();
+		end = CYCLES();
+		if ((uint16_t)(end - start) < overhead) {
+			overhead = end - start;
+		}
+	}
+
+	sprintf(line, "cycles at %lu Hz, %u runs each, less %u",
+	 (unsigned long)configCPU_CLOCK_HZ, BENCH_RUNS, overhead);
+	vPrint(line);
+	sprintf(line, "run time stats %d, trace recorder %d",
+	 configGENERATE_RUN_TIME_STATS, configUSE_TRACE_RECORDER);
+	vPrint(line);
+	sprintf(line, "%s task selection, %d priorities",
+	 configUSE_PORT_OPTIMISED_TASK_SELECTION ? "bitmap" : "list scan",
+	 configMAX_PRIORITIES);
+	vPrint(line);
+	sprintf(line, "%-24s %6s %6s %6s", "", "fewest", "mean", "most");
+	vPrint(line);
+
+	/* Giving from an interrupt when no task is waiting. */
+	prvStatsReset(&stats);
+	for (run = 0; run < BENCH_RUNS; run++) {
+		woken = pdFALSE;
+		portENTER_CRITICAL();
+		start = CYCLES();
+		xSemaphoreGiveFromISR(semaphore, &woken);
+		end = CYCLES();
+		portEXIT_CRITICAL();
+		prvStatsAdd(&stats, (uint16_t)(end - start));
+		xSemaphoreTake(semaphore, 0);
+	}
+	prvStatsReport("semaphore give, no wait", &stats);
+
+	prvStatsReset(&stats);
+	for (run = 0; run < BENCH_RUNS; run++) {
+		woken = pdFALSE;
+		portENTER_CRITICAL();
+		start = CYCLES();
+		xTaskNotifyFromISR(runner, 0, eIncrement, &woken);
+		end = CYCLES();
+		portEXIT_CRITICAL();
+		prvStatsAdd(&stats, (uint16_t)(end - start));
+		ulTaskNotifyTake(pdTRUE, 0);
+	}
+	prvStatsReport("notify give, no wait", &stats);
+
+	/* Taking what was given, without blocking. */
+	prvStatsReset(&stats);
+	for (run = 0; run < BENCH_RUNS; run++) {
+		xSemaphoreGive(semaphore);
+		start = CYCLES();
+		xSemaphoreTake(semaphore, 0);
+		end = CYCLES();
+		prvStatsAdd(&stats, (uint16_t)(end - start));
+	}
+	prvStatsReport("semaphore take", &stats);
+
+	prvStatsReset(&stats);
+	for (run = 0; run < BENCH_RUNS; run++) {
+		xTaskNotify(runner, 0, eIncrement);
+		start = CYCLES();
+		ulTaskNotifyTake(pdTRUE, 0);
+		end = CYCLES();
+		prvStatsAdd(&stats, (uint16_t)(end - start));
+	}
+	prvStatsReport("notify take", &stats);
+
+	/* From the give in an interrupt to the woken task running, which the
+	 * waiter adds, and from the waiter blocking again to this task running. */
+	xTaskCreate(prvSemaphoreWaiterTask, (signed char *) "s", WAITER_STACK, NULL,
+	 WAITER_PRIORITY, NULL);
+	xTaskCreate(prvNotifyWaiterTask, (signed char *) "n", WAITER_STACK, NULL,
+	 WAITER_PRIORITY, &notifyWaiter);
+	prvStatsReset(&wakeStats);
+	prvStatsReset(&stats);
+	for (run = 0; run < BENCH_RUNS; run++) {
+		woken = pdFALSE;
+		portENTER_CRITICAL();
+		started = CYCLES();
+		xSemaphoreGiveFromISR(semaphore, &woken);
+		portEXIT_CRITICAL();
+		if (woken == pdTRUE) {
+			taskYIELD();
+		}
+		prvStatsAdd(&stats, CYCLES_SINCE(blocked));
+	}
+	prvStatsReport("semaphore wake", &wakeStats);
+	prvStatsReport("switch down, semaphore", &stats);
+
+	prvStatsReset(&wakeStats);
+	prvStatsReset(&stats);
+	for (run = 0; run < BENCH_RUNS; run++) {
+		woken = pdFALSE;
+		portENTER_CRITICAL();
+		started = CYCLES();
+		xTaskNotifyFromISR(notifyWaiter, 0, eIncrement, &woken);
+		portEXIT_CRITICAL();
+		if (woken == pdTRUE) {
+			taskYIELD();
+		}
+		prvStatsAdd(&stats, CYCLES_SINCE(blocked));
+	}
+	prvStatsReport("notify wake", &wakeStats);
+	prvStatsReport("switch down, notify", &stats);
+
+	/* A yield to another task at the same priority. The partner adds each
+	 * run, and is left suspended after. A tick which switches to the partner
+	 * between the flag and the yield makes one run long. */
+	xTaskCreate(prvPartnerTask, (signed char *) "p", WAITER_STACK, NULL,
+	 RUNNER_PRIORITY, &partner);
+	prvStatsReset(&stats);
+	for (run = 0; run < BENCH_RUNS; run++) {
+		yielding = pdTRUE;
+		started = CYCLES();
+		taskYIELD();
+	}
+	vTaskSuspend(partner);
+	prvStatsReport("yield, same priority", &stats);
+
+	sprintf(line, "binary semaphore: %u heap bytes", (unsigned int)semaphoreBytes);
+	vPrint(line);
+	sprintf(line, "notification: %u bytes in every TCB", NOTIFY_TCB_BYTES);
+	vPrint(line);
+
+	prvStepBenchmarks();
+	prvWriteBenchmarks();
+	vPrint("benchmarks done");
+
+	vTaskSuspend(NULL);
+}
+
+/*******************************************************************************
+* Function: prvWriteBenchmarks
+*
+* Description: Times handing a SET_POS to the link both ways it has been sent:
+*  as one USART_WriteBlock into the transmit ring, which includes the UDRE
+*  interrupt that starts sending it, and as one xQueueSendToBack a byte, each
+*  of which wakes a task like USART_Write_Task to take the byte off the queue.
+*  That task would then spin on UDRE0 for the byte to go, at the line rate,
+*  which is not counted; this one drops it. The SET_POS moves a sprite made
+*  for it, as the host refuses any other.
+*******************************************************************************/
+static void prvWriteBenchmarks(void) {
+	uint8_t command[6];
+	xSpriteHandle sprite;
+	uint16_t run, start, end;
+	uint8_t i;
+
+	sprite = xSpriteCreate("bullet.png", SCREEN_W / 2, SCREEN_H / 2, 0,
+	 BULLET_SIZE, BULLET_SIZE, 1);
+	if (sprite == ERROR_HANDLE) {
+		vPrint("no sprite for the write benchmarks");
+		return;
+	}
+	command[0] = SET_POS;
+	command[1] = sprite;
+	command[2] = (SCREEN_W / 2) >> 8;
+	command[3] = (SCREEN_W / 2) & 0x00FF;
+	command[4] = (SCREEN_H / 2) >> 8;
+	command[5] = (SCREEN_H / 2) & 0x00FF;
+
+	vPrint("one SET_POS to the link");
+	sprintf(line, "%-24s %6s %6s %6s", "", "fewest", "mean", "most");
+	vPrint(line);
+
+	vTaskDelay(WRITE_DRAIN_TICKS);
+	prvStatsReset(&stats);
+	for (run = 0; run < BENCH_RUNS; run++) {
+		vTaskDelay(WRITE_SETTLE_TICKS);
+		start = CYCLES();
+		USART_WriteBlock(command, sizeof(command));
+		end = CYCLES();
+		prvStatsAdd(&stats, (uint16_t)(end - start));
+	}
+	prvStatsReport("one block, ring", &stats);
+
+	writeQueue = xQueueCreate(WRITE_QUEUE_LENGTH, sizeof(uint8_t));
+	if (writeQueue == NULL) {
+		vPrint("no heap for the byte queue");
+		return;
+	}
+	xTaskCreate(prvWriteTask, (signed char *) "w", WAITER_STACK, NULL,
+	 WAITER_PRIORITY, NULL);
+	prvStatsReset(&stats);
+	for (run = 0; run < BENCH_RUNS; run++) {
+		start = CYCLES();
+		for (i = 0; i < sizeof(command); i++) {
+			xQueueSendToBack(writeQueue, &command[i], 0);
+		}
+		end = CYCLES();
+		prvStatsAdd(&stats, (uint16_t)(end - start));
+	}
+	sprintf(line, "%u sends, byte queue", (unsigned int)sizeof(command));
+	prvStatsReport(line, &stats);
+
+	vSpriteDelete(sprite);
+}
+
+/*******************************************************************************
+* Function: prvStepBenchmarks
+*
+* Description: Times one step of the game simulation with 5, 50 and 150
+*  objects: moving and wrapping the ship, bullets and asteroids, spinning the
+*  asteroids, building the collision grid and querying it for every bullet and
+*  the ship, as updateTask does before it asks the host about any near bodies.
+*  The same step is then timed with float positions and velocities and the
+*  ship's thrust from sin and cos, as updateTask did before the fixed-point
+*  physics. Neither includes the host round trips. The stores are too big
+*  for the runner's stack, so they come from the heap.
+*******************************************************************************/
+static void prvStepBenchmarks(void) {
+	static const uint8_t counts[] = { 5, 50, STEP_MAX_OBJECTS };
+	uint8_t i, j, bulletCount;
+	uint16_t run;
+	xStepStorage *storage;
+
+	vPrint("one simulation step");
+	sprintf(line, "%-24s %6s %6s %6s", "", "fewest", "mean", "most");
+	vPrint(line);
+
+	/* heap_2 never joins freed blocks, so both stores share one. */
+	storage = pvPortMalloc(sizeof(xStepStorage));
+	if (storage == NULL) {
+		vPrint("no heap for the step store");
+		return;
+	}
+	store = &storage->fixed;
+	floatStore = &storage->floating;
+
+	for (i = 0; i < sizeof(counts); i++) {
+		bulletCount = STEP_BULLETS(counts[i]);
+		prvStepFill(counts[i] - bulletCount, bulletCount);
+		prvStatsReset(&stats);
+		for (run = 0; run < STEP_RUNS; run++) {
+			prvStatsAdd(&stats, prvTimeStep(prvStep, counts[i] - bulletCount,
+			 bulletCount));
+		}
+		sprintf(line, "fixed, %u objects", counts[i]);
+		prvStatsReport(line, &stats);
+	}
+
+	for (i = 0; i < sizeof(counts); i++) {
+		bulletCount = STEP_BULLETS(counts[i]);
+		srand(counts[i]);
+		for (j = 0; j < counts[i]; j++) {
+			floatStore->pos[j].x = rand() % SCREEN_W;
+			floatStore->pos[j].y = rand() % SCREEN_H;
+			floatStore->vel[j].x = (rand() % 800 - 400) / 100.0;
+			floatStore->vel[j].y = (rand() % 800 - 400) / 100.0;
+			floatStore->angle[j] = rand() % 360;
+			floatStore->aVel[j] = rand() % (2 * AST_MAX_AVEL + 1) - AST_MAX_AVEL;
+			floatStore->size[j] = rand() % 3 + 1;
+		}
+		shipFloatPos.x = SCREEN_W / 2;
+		shipFloatPos.y = SCREEN_H / 2;
+		shipFloatVel.x = 0.0;
+		shipFloatVel.y = 0.0;
+		prvStatsReset(&stats);
+		for (run = 0; run < STEP_RUNS; run++) {
+			prvStatsAdd(&stats, prvTimeStep(prvFloatStep,
+			 counts[i] - bulletCount, bulletCount));
+		}
+		sprintf(line, "float, %u objects", counts[i]);
+		prvStatsReport(line, &stats);
+	}
+	vPortFree(storage);
+}
+
+/*******************************************************************************
+* Function: prvTimeStep
+*
+* Description: Times one step with interrupts disabled, so no tick lands in it.
+*  A step may run past one wrap of Timer4, which its overflow flag shows, but
+*  not two: it must take under 131072 cycles, 8ms.
+*
+* return: The cycles the step took, before the counter overhead is taken off
+*******************************************************************************/
+static uint32_t prvTimeStep(void (*step)(uint8_t, uint8_t), uint8_t asteroidCount,
+ uint8_t bulletCount) {
+	uint16_t start, end;
+	uint32_t cycles;
+	uint8_t wrapped;
+
+	portENTER_CRITICAL();
+	TIFR4 = _BV(TOV4);
+	start = CYCLES();
+	step(asteroidCount, bulletCount);
+	end = CYCLES();
+	wrapped = (TIFR4 & _BV(TOV4)) != 0;
+	portEXIT_CRITICAL();
+
+	cycles = (uint16_t)(end - start);
+	if (wrapped && end >= start) {
+		cycles += 0x10000UL;
+	}
+	return cycles;
+}
+
+/*******************************************************************************
+* Function: prvStepFill
+*
+* Description: Places the ship in the middle of the window and scatters the
+*  asteroids and bullets over it at random, seeded by their number so every
+*  run sees the same field.
+*******************************************************************************/
+static void prvStepFill(uint8_t asteroidCount, uint8_t bulletCount) {
+	uint8_t i;
+	int16_t heading;
+
+	srand(asteroidCount + bulletCount);
+	for (i = 0; i < asteroidCount + bulletCount; i++) {
+		store->pos[i].x = PIX_TO_POS(rand() % SCREEN_W);
+		store->pos[i].y = PIX_TO_POS(rand() % SCREEN_H);
+		store->angle[i] = rand() % 360;
+		if (i < asteroidCount) {
+			store->vel[i].x = rand() % (2 * AST_MAX_VEL) - AST_MAX_VEL;
+			store->vel[i].y = rand() % (2 * AST_MAX_VEL) - AST_MAX_VEL;
+			store->aVel[i] = rand() % (2 * AST_MAX_AVEL + 1) - AST_MAX_AVEL;
+			store->size[i] = rand() % 3 + 1;
+		} else {
+			heading = rand() % 360;
+			store->vel[i].x = -fxMulSin(BULLET_VEL, fxSin(heading));
+			store->vel[i].y = -fxMulSin(BULLET_VEL, fxCos(heading));
+			store->life[i] = rand() % BULLET_LIFE_FRAMES;
+		}
+	}
+	shipPos.x = PIX_TO_POS(SCREEN_W / 2);
+	shipPos.y = PIX_TO_POS(SCREEN_H / 2);
+	shipVel.x = 0;
+	shipVel.y = 0;
+	shipAngle = 0;
+}
+
+/*******************************************************************************
+* Function: prvStep
+*
+* Description: One fixed-point step, as updateTask takes it. A bullet which
+*  runs out of life is given a new one, where updateTask would remove it and
+*  send its sprite away.
+*******************************************************************************/
+static void prvStep(uint8_t asteroidCount, uint8_t bulletCount) {
+	xSpriteHandle hit;
+	uint8_t i, last = asteroidCount + bulletCount, near = 0;
+
+	shipAngle += 6;
+	if (shipAngle >= 360) {
+		shipAngle -= 360;
+	}
+	shipVel.x -= fxMulSin(SHIP_ACCEL, fxSin(shipAngle));
+	shipVel.y -= fxMulSin(SHIP_ACCEL, fxCos(shipAngle));
+	prvMovePoint(&shipPos, &shipVel);
+
+	for (i = asteroidCount; i < last; i++) {
+		if (++store->life[i] >= BULLET_LIFE_FRAMES) {
+			store->life[i] = 0;
+		}
+		prvMovePoint(&store->pos[i], &store->vel[i]);
+	}
+
+	for (i = 0; i < asteroidCount; i++) {
+		prvMovePoint(&store->pos[i], &store->vel[i]);
+		store->angle[i] += store->aVel[i];
+		if (store->angle[i] >= 360) {
+			store->angle[i] -= 360;
+		} else if (store->angle[i] < 0) {
+			store->angle[i] += 360;
+		}
+	}
+
+	vCollisionClear();
+	for (i = 0; i < asteroidCount; i++) {
+		xCollisionInsert(i, POS_TO_PIX(store->pos[i].x),
+		 POS_TO_PIX(store->pos[i].y),
+		 BOUNDING_RADIUS(prvSizeToPix(store->size[i])));
+	}
+	for (i = asteroidCount; i < last; i++) {
+		near += uCollisionQuery(POS_TO_PIX(store->pos[i].x),
+		 POS_TO_PIX(store->pos[i].y), BOUNDING_RADIUS(BULLET_SIZE), &hit, 1);
+	}
+	near += uCollisionQuery(POS_TO_PIX(shipPos.x), POS_TO_PIX(shipPos.y),
+	 BOUNDING_RADIUS(SHIP_SIZE), &hit, 1);
+
+	stepNear = near;
+}
+
+/*******************************************************************************
+* Function: prvFloatStep
+*
+* Description: prvStep with float positions and velocities, wrapped with float
+*  compares, and the ship's thrust from sin and cos of its angle in radians.
+*  The grid is built from the same positions converted to whole pixels.
+*******************************************************************************/
+static void prvFloatStep(uint8_t asteroidCount, uint8_t bulletCount) {
+	xSpriteHandle hit;
+	xFloatPoint *pos;
+	uint8_t i, last = asteroidCount + bulletCount, near = 0;
+
+	shipAngle += 6;
+	if (shipAngle >= 360) {
+		shipAngle -= 360;
+	}
+	shipFloatVel.x += 0.1 * -sin(shipAngle * DEG_TO_RAD);
+	shipFloatVel.y += 0.1 * -cos(shipAngle * DEG_TO_RAD);
+
+	for (i = 0; i <= last; i++) {
+		pos = i < last ? &floatStore->pos[i] : &shipFloatPos;
+		pos->x += i < last ? floatStore->vel[i].x : shipFloatVel.x;
+		pos->y += i < last ? floatStore->vel[i].y : shipFloatVel.y;
+		if (pos->x < 0) {
+			pos->x += SCREEN_W;
+		} else if (pos->x > SCREEN_W) {
+			pos->x -= SCREEN_W;
+		}
+		if (pos->y < 0) {
+			pos->y += SCREEN_H;
+		} else if (pos->y > SCREEN_H) {
+			pos->y -= SCREEN_H;
+		}
+		if (i < asteroidCount) {
+			floatStore->angle[i] += floatStore->aVel[i];
+			if (floatStore->angle[i] >= 360) {
+				floatStore->angle[i] -= 360;
+			} else if (floatStore->angle[i] < 0) {
+				floatStore->angle[i] += 360;
+			}
+		}
+	}
+
+	vCollisionClear();
+	for (i = 0; i < asteroidCount; i++) {
+		xCollisionInsert(i, (uint16_t)floatStore->pos[i].x,
+		 (uint16_t)floatStore->pos[i].y,
+		 BOUNDING_RADIUS(prvSizeToPix(floatStore->size[i])));
+	}
+	for (i = asteroidCount; i < last; i++) {
+		near += uCollisionQuery((uint16_t)floatStore->pos[i].x,
+		 (uint16_t)floatStore->pos[i].y, BOUNDING_RADIUS(BULLET_SIZE), &hit, 1);
+	}
+	near += uCollisionQuery((uint16_t)shipFloatPos.x, (uint16_t)shipFloatPos.y,
+	 BOUNDING_RADIUS(SHIP_SIZE), &hit, 1);
+
+	stepNear = near;
+}
+
+/*******************************************************************************
+* Function: prvMovePoint
+*
+* Description: Advances a position by one frame of velocity and wraps it
+*  around the edges of the window, as movePoint in asteroids.c does.
+*******************************************************************************/
+static void prvMovePoint(xPoint *pos, const xPoint *vel) {
+	pos->x += VEL_TO_POS(vel->x);
+	pos->y += VEL_TO_POS(vel->y);
+
+	if (pos->x < 0) {
+		pos->x += SCREEN_W_POS;
+	} else if (pos->x > SCREEN_W_POS) {
+		pos->x -= SCREEN_W_POS;
+	}
+
+	if (pos->y < 0) {
+		pos->y += SCREEN_H_POS;
+	} else if (pos->y > SCREEN_H_POS) {
+		pos->y -= SCREEN_H_POS;
+	}
+}
+
+/*******************************************************************************
+* Function: prvSizeToPix
+*
+* Description: The sprite size in pixels of an asteroid size, as sizeToPix in
+*  asteroids.c gives it.
+*******************************************************************************/
+static uint8_t prvSizeToPix(uint8_t size) {
+	switch (size) {
+		case 3:
+			return 100;
+		case 2:
+			return 40;
+		default:
+			return 15;
+	}
+}
+
+/*******************************************************************************
+* Function: prvWriteTask
+*
+* Description: Takes each byte off the write queue as USART_Write_Task did,
+*  but drops it rather than sending it.
+*******************************************************************************/
+static void prvWriteTask(void *params) {
+	uint8_t data;
+
+	for (;;) {
+		xQueueReceive(writeQueue, &data, portMAX_DELAY);
+	}
+}
+
+/*******************************************************************************
+* Function: prvSemaphoreWaiterTask
+*
+* Description: Blocks on the semaphore and adds the cycles since the runner
+*  gave it. The time it blocks at is where the switch down starts.
+*******************************************************************************/
+static void prvSemaphoreWaiterTask(void *params) {
+	for (;;) {
+		blocked = CYCLES();
+		xSemaphoreTake(semaphore, portMAX_DELAY);
+		prvStatsAdd(&wakeStats, CYCLES_SINCE(started));
+	}
+}
+
+/*******************************************************************************
+* Function: prvNotifyWaiterTask
+*
+* Description: Blocks on its notification and adds the cycles since the runner
+*  gave it. The time it blocks at is where the switch down starts.
+*******************************************************************************/
+static void prvNotifyWaiterTask(void *params) {
+	for (;;) {
+		blocked = CYCLES();
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		prvStatsAdd(&wakeStats, CYCLES_SINCE(started));
+	}
+}
+
+/*******************************************************************************
+* Function: prvPartnerTask
+*
+* Description: Adds the cycles since the runner yielded to it, and yields
+*  back. Runs the tick gives it are not counted.
+*******************************************************************************/
+static void prvPartnerTask(void *params) {
+	for (;;) {
+		if (yielding == pdTRUE) {
+			prvStatsAdd(&stats, CYCLES_SINCE(started));
+			yielding = pdFALSE;
+		}
+		taskYIELD();
+	}
+}
+
+#endif /* configRUN_KERNEL_BENCHMARK */
@@ -0,0 +1,10 @@
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include "FreeRTOS.h"
+
+/* Creates the benchmark tasks in place of the game's. They run once the
+ * scheduler starts and print their results on the host. */
+void vBenchmarkStart(void);
+
+#endif /* BENCHMARK_H_ */
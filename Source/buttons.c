@@ -0,0 +1,115 @@
+/*******************************************************************************
+* File: buttons.c
+*
+* Description: An interrupt-driven driver for active-low push buttons on port
+*  B. The pin-change interrupt debounces each pin by ignoring further edges on
+*  it for BUTTON_DEBOUNCE_MS after an accepted one, and notifies the waiting
+*  task after each accepted change. The notification value collects the
+*  buttons pressed since the task last looked, so a tap shorter than the
+*  task's reaction time is still seen. Tasks block on the notification rather
+*  than polling the pins.
+*
+*******************************************************************************/
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "buttons.h"
+
+#define BUTTON_DEBOUNCE_TICKS (BUTTON_DEBOUNCE_MS / portTICK_RATE_MS)
+
+static xTaskHandle waiter = NULL;
+static uint8_t watched = 0;
+static volatile uint8_t pressed = 0;
+static uint8_t released = 0;
+static portTickType lastEdge[8];
+
+/*******************************************************************************
+* Function: vButtonsInit
+*
+* Description: Makes the given pins of port B inputs and starts reporting
+*  their changes. Must be called once, before any task waits on the buttons.
+*
+* param mask: The pins of port B with buttons on them
+*******************************************************************************/
+void vButtonsInit(uint8_t mask) {
+	portENTER_CRITICAL();
+	DDRB &= ~mask;
+	watched = mask;
+	pressed = ~PINB & mask;
+	PCMSK0 |= mask;
+	PCIFR = _BV(PCIF0);
+	PCICR |= _BV(PCIE0);
+	portEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+* Function: uButtonsWait
+*
+* Description: Blocks until a button changes state or the timeout passes. A
+*  timeout samples the pins directly, which recovers from an edge that was
+*  lost to debouncing. Only one task may wait on the buttons, and it must not
+*  use its task notification for anything else.
+*
+* param timeout: The longest time to block, in ticks
+* return: A mask of the watched pins whose buttons are held down, or were
+*  pressed since the last call
+*******************************************************************************/
+uint8_t uButtonsWait(portTickType timeout) {
+	unsigned long taps;
+	uint8_t state;
+
+	waiter = xTaskGetCurrentTaskHandle();
+
+	/* A tap reported last time has already been let go, so report that
+	straight away instead of holding it until the next edge. */
+	if (released != 0) {
+		timeout = 0;
+	}
+
+	if (xTaskNotifyWait(0, ~0UL, &taps, timeout) != pdTRUE) {
+		portENTER_CRITICAL();
+		pressed = ~PINB & watched;
+		portEXIT_CRITICAL();
+		taps = 0;
+	}
+
+	state = pressed;
+	released = (uint8_t)taps & ~state;
+
+	return state | (uint8_t)taps;
+}
+
+/* Pin-change interrupt for port B. Accepts the changed pins that are outside
+their lockout period and notifies the waiting task, setting the bits of the
+newly pressed buttons in its notification value. */
+ISR( PCINT0_vect )
+{
+	portTickType now = xTaskGetTickCountFromISR();
+	uint8_t changed = (~PINB & watched) ^ pressed;
+	uint8_t accepted = 0;
+	uint8_t bit, pin;
+	portBASE_TYPE woken = pdFALSE;
+
+	for (pin = 0, bit = 1; changed != 0; pin++, bit <<= 1) {
+		if (changed & bit) {
+			changed &= ~bit;
+			if ((portTickType)(now - lastEdge[pin]) >= BUTTON_DEBOUNCE_TICKS) {
+				lastEdge[pin] = now;
+				accepted |= bit;
+			}
+		}
+	}
+
+	if (accepted != 0) {
+		pressed ^= accepted;
+		if (waiter != NULL) {
+			xTaskNotifyFromISR(waiter, accepted & pressed, eSetBits, &woken);
+		}
+		if (woken != pdFALSE) {
+			taskYIELD();
+		}
+	}
+}
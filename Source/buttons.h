@@ -0,0 +1,14 @@
+#ifndef BUTTONS_H_
+#define BUTTONS_H_
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+/* Edges on a pin closer together than this are treated as contact bounce. */
+#define BUTTON_DEBOUNCE_MS 20
+
+void vButtonsInit(uint8_t mask);
+uint8_t uButtonsWait(portTickType timeout);
+
+#endif /* BUTTONS_H_ */
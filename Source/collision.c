@@ -0,0 +1,173 @@
+/*******************************************************************************
+* File: collision.c
+*
+* Description: Circle-versus-circle collision tests done on the AVR, so that
+*  only bodies which may touch need a round trip to the external graphics
+*  context. Given circles which cover the sprites at every angle, as the
+*  external graphics context's own broad phase uses, every pair its masks
+*  report as touching is found here as well. Positions are not wrapped at the
+*  window's edges, which the external graphics context does not do either.
+*  This is only a broad phase: hits are still decided by the external graphics
+*  context's masks, so every body found near another costs a COLLIDE round
+*  trip, and the host does more than render. Deciding hits here from the
+*  circles alone was rejected, as they overlap the corners of the ragged
+*  asteroid images where the masks do not, and shots which miss by a few
+*  pixels would destroy them. updateTask counts the round trips which remain.
+*  Bodies are bucketed into a uniform grid over the window by their center, so
+*  a query only visits the few cells its circle (grown by the largest body
+*  radius) can reach. All math is done on integer pixel coordinates.
+*
+*******************************************************************************/
+#include "collision.h"
+
+/* 128 pixel cells cover an 800x600 window with a 7x5 grid. */
+#define CELL_SHIFT          7
+#define GRID_COLS           7
+#define GRID_ROWS           5
+#define NO_BODY             0xFF
+
+typedef struct {
+	xSpriteHandle sprite;
+	uint16_t x;
+	uint16_t y;
+	uint8_t radius;
+	uint8_t next;
+} xBody;
+
+static xBody bodies[COLLISION_MAX_BODIES];
+static uint8_t bodyCount = 0;
+static uint8_t maxRadius = 0;
+static uint8_t cells[GRID_ROWS][GRID_COLS];
+
+static uint8_t prvCellCol(int16_t x);
+static uint8_t prvCellRow(int16_t y);
+
+/*******************************************************************************
+* Function: vCollisionClear
+*
+* Description: Removes every body from the collision grid. Typically called
+*  once per frame before the bodies are inserted at their new positions.
+*******************************************************************************/
+void vCollisionClear(void) {
+	uint8_t row, col;
+
+	for (row = 0; row < GRID_ROWS; row++) {
+		for (col = 0; col < GRID_COLS; col++) {
+			cells[row][col] = NO_BODY;
+		}
+	}
+	bodyCount = 0;
+	maxRadius = 0;
+}
+
+/*******************************************************************************
+* Function: xCollisionInsert
+*
+* Description: Adds a circular body to the collision grid.
+*
+* param sprite: The handle reported in the hits of queries touching the body
+* param x: x-position of the body's center in window coordinates
+* param y: y-position of the body's center in window coordinates
+* param radius: Radius of the body in pixels
+* return: pdTRUE on success; pdFALSE if the grid is full
+*******************************************************************************/
+portBASE_TYPE xCollisionInsert(xSpriteHandle sprite, uint16_t x, uint16_t y,
+ uint8_t radius) {
+	xBody *body;
+	uint8_t row, col;
+
+	if (bodyCount == COLLISION_MAX_BODIES) {
+		return pdFALSE;
+	}
+
+	row = prvCellRow(y);
+	col = prvCellCol(x);
+
+	body = &bodies[bodyCount];
+	body->sprite = sprite;
+	body->x = x;
+	body->y = y;
+	body->radius = radius;
+	body->next = cells[row][col];
+	cells[row][col] = bodyCount++;
+
+	if (radius > maxRadius) {
+		maxRadius = radius;
+	}
+
+	return pdTRUE;
+}
+
+/*******************************************************************************
+* Function: uCollisionQuery
+*
+* Description: Finds every body in the collision grid which overlaps the given
+*  circle. Touching circles count as overlapping.
+*
+* param x: x-position of the circle's center in window coordinates
+* param y: y-position of the circle's center in window coordinates
+* param radius: Radius of the circle in pixels
+* param hits: An array in which to store the handles of the overlapping bodies
+* param hitsSize: The size of the hits array
+* return: The number of overlapping bodies, which may be larger than the
+*  number stored in the hits array
+*******************************************************************************/
+uint8_t uCollisionQuery(uint16_t x, uint16_t y, uint8_t radius,
+ xSpriteHandle hits[], uint8_t hitsSize) {
+	int16_t reach = (int16_t)radius + maxRadius;
+	uint8_t rowFirst = prvCellRow((int16_t)y - reach);
+	uint8_t rowLast = prvCellRow((int16_t)y + reach);
+	uint8_t colFirst = prvCellCol((int16_t)x - reach);
+	uint8_t colLast = prvCellCol((int16_t)x + reach);
+	uint8_t row, col, index, hitCount = 0;
+	int16_t dx, dy;
+	uint16_t sum;
+	xBody *body;
+
+	for (row = rowFirst; row <= rowLast; row++) {
+		for (col = colFirst; col <= colLast; col++) {
+			for (index = cells[row][col]; index != NO_BODY; index = body->next) {
+				body = &bodies[index];
+				dx = (int16_t)(x - body->x);
+				dy = (int16_t)(y - body->y);
+				sum = (uint16_t)radius + body->radius;
+				if ((int32_t)dx * dx + (int32_t)dy * dy <= (int32_t)sum * sum) {
+					if (hitCount < hitsSize) {
+						hits[hitCount] = body->sprite;
+					}
+					hitCount++;
+				}
+			}
+		}
+	}
+
+	return hitCount;
+}
+
+/*******************************************************************************
+* Function: prvCellCol
+*
+* Description: Maps an x-coordinate onto a grid column, clamping coordinates
+*  outside the window onto the edge columns.
+*******************************************************************************/
+static uint8_t prvCellCol(int16_t x) {
+	if (x < 0) {
+		return 0;
+	}
+	x >>= CELL_SHIFT;
+	return x >= GRID_COLS ? GRID_COLS - 1 : (uint8_t)x;
+}
+
+/*******************************************************************************
+* Function: prvCellRow
+*
+* Description: Maps a y-coordinate onto a grid row, clamping coordinates
+*  outside the window onto the edge rows.
+*******************************************************************************/
+static uint8_t prvCellRow(int16_t y) {
+	if (y < 0) {
+		return 0;
+	}
+	y >>= CELL_SHIFT;
+	return y >= GRID_ROWS ? GRID_ROWS - 1 : (uint8_t)y;
+}
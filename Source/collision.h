@@ -0,0 +1,21 @@
+#ifndef COLLISION_H_
+#define COLLISION_H_
+
+#include "FreeRTOS.h"
+#include "graphics.h"
+
+/* Largest number of bodies the collision grid can hold at once. The kernel
+ * benchmark fills it with up to 150 asteroids, more than a game ever has. */
+#if configRUN_KERNEL_BENCHMARK == 1
+#define COLLISION_MAX_BODIES 160
+#else
+#define COLLISION_MAX_BODIES 64
+#endif
+
+void vCollisionClear(void);
+portBASE_TYPE xCollisionInsert(xSpriteHandle sprite, uint16_t x, uint16_t y,
+ uint8_t radius);
+uint8_t uCollisionQuery(uint16_t x, uint16_t y, uint8_t radius,
+ xSpriteHandle hits[], uint8_t hitsSize);
+
+#endif /* COLLISION_H_ */
@@ -0,0 +1,85 @@
+/*******************************************************************************
+* File: fixed.c
+*
+* Description: Integer trigonometry for the game physics, which has no FPU to
+*  lean on. Sines come from a quarter-wave table kept in flash and indexed by
+*  whole degrees, the same unit sprite angles are kept in.
+*
+*******************************************************************************/
+#include <avr/pgmspace.h>
+
+#include "fixed.h"
+
+/* sin(0..90 degrees) in Q1.14. The other three quadrants are mirrors of it. */
+static const int16_t PROGMEM sineTable[91] = {
+	    0,   286,   572,   857,  1143,  1428,  1713,  1997,
+	 2280,  2563,  2845,  3126,  3406,  3686,  3964,  4240,
+	 4516,  4790,  5063,  5334,  5604,  5872,  6138,  6402,
+	 6664,  6924,  7182,  7438,  7692,  7943,  8192,  8438,
+	 8682,  8923,  9162,  9397,  9630,  9860, 10087, 10311,
+	10531, 10749, 10963, 11174, 11381, 11585, 11786, 11982,
+	12176, 12365, 12551, 12733, 12911, 13085, 13255, 13421,
+	13583, 13741, 13894, 14044, 14189, 14330, 14466, 14598,
+	14726, 14849, 14968, 15082, 15191, 15296, 15396, 15491,
+	15582, 15668, 15749, 15826, 15897, 15964, 16026, 16083,
+	16135, 16182, 16225, 16262, 16294, 16322, 16344, 16362,
+	16374, 16382, 16384
+};
+
+/*******************************************************************************
+* Function: fxSin
+*
+* Description: Looks up the sine of an angle.
+*
+* param angle: The angle in degrees. Angles in [0,360) take the fast path.
+* return: The sine of the angle in Q1.14
+*******************************************************************************/
+int16_t fxSin(int16_t angle) {
+	if (angle < 0 || angle >= 360) {
+		angle %= 360;
+		if (angle < 0) {
+			angle += 360;
+		}
+	}
+
+	if (angle <= 90) {
+		return (int16_t)pgm_read_word(&sineTable[angle]);
+	} else if (angle <= 180) {
+		return (int16_t)pgm_read_word(&sineTable[180 - angle]);
+	} else if (angle <= 270) {
+		return -(int16_t)pgm_read_word(&sineTable[angle - 180]);
+	}
+	return -(int16_t)pgm_read_word(&sineTable[360 - angle]);
+}
+
+/*******************************************************************************
+* Function: fxCos
+*
+* Description: Looks up the cosine of an angle.
+*
+* param angle: The angle in degrees
+* return: The cosine of the angle in Q1.14
+*******************************************************************************/
+int16_t fxCos(int16_t angle) {
+	angle += 90;
+	if (angle >= 360) {
+		angle -= 360;
+	}
+	return fxSin(angle);
+}
+
+/*******************************************************************************
+* Function: fxMulSin
+*
+* Description: Scales a fixed-point value by a sine or cosine, keeping the
+*  value's own format.
+*
+* param value: The value to scale, in any Q format
+* param sine: The factor in Q1.14, as returned by fxSin or fxCos
+* return: value * sine, rounded to nearest. Only -32768 * -1.0 does not fit.
+*******************************************************************************/
+int16_t fxMulSin(int16_t value, int16_t sine) {
+	int32_t product = (int32_t)value * sine;
+
+	return (int16_t)((product + (1L << (SIN_FRAC_BITS - 1))) >> SIN_FRAC_BITS);
+}
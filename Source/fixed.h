@@ -0,0 +1,28 @@
+#ifndef FIXED_H_
+#define FIXED_H_
+
+#include <stdint.h>
+
+/* Positions are kept in Q12.4 pixels and velocities in Q8.8 pixels per frame,
+ * both in an int16_t. Sines are returned in Q1.14. */
+#define POS_FRAC_BITS 4
+#define VEL_FRAC_BITS 8
+#define SIN_FRAC_BITS 14
+
+/* Conversions between whole pixels and Q12.4 positions. */
+#define PIX_TO_POS(pix) ((int16_t)((pix) * (1 << POS_FRAC_BITS)))
+#define POS_TO_PIX(pos) ((uint16_t)((pos) >> POS_FRAC_BITS))
+
+/* A non-negative velocity constant, e.g. VEL_CONST(0.1), in Q8.8. */
+#define VEL_CONST(v) ((int16_t)((v) * (1 << VEL_FRAC_BITS) + 0.5))
+
+/* The distance moved by a Q8.8 velocity in one frame as a Q12.4 position
+ * offset, rounded to the nearest sixteenth of a pixel. */
+#define VEL_TO_POS(vel) ((int16_t)(((vel) + \
+ (1 << (VEL_FRAC_BITS - POS_FRAC_BITS - 1))) >> (VEL_FRAC_BITS - POS_FRAC_BITS)))
+
+int16_t fxSin(int16_t angle);
+int16_t fxCos(int16_t angle);
+int16_t fxMulSin(int16_t value, int16_t sine);
+
+#endif /* FIXED_H_ */
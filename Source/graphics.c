@@ -1,5 +1,8 @@
+#include <string.h>
+
 #include "graphics.h"
 #include "usart.h"
+#include "task.h"
 
 /* Sprite functions */
 #define CREATE_SPRITE       0x01
@@ -19,24 +22,292 @@
 #define CREATE_WINDOW       0x0A
 #define PYTHON_PRINT        0x0B
 
+/* Frame functions */
+#define BEGIN_FRAME         0x0E
+#define SPRITE_BATCH        0x0F
+#define END_FRAME           0x10
+#define SPRITE_DELTA        0x11
+
+/* Reply functions */
+#define REQUEST_TAG         0x12
+
+/* Link functions */
+#define NEGOTIATE_BAUD      0x13
+#define LINK_PROBE          0x14
+#define LINK_PROBE_PATTERN  0xA5
+#define LINK_TEST           0x1E
+#define LINK_CONFIRM        0x1F
+
+/* Image functions */
+#define REGISTER_IMAGE      0x15
+#define CREATE_SPRITE_BY_ID 0x16
+
+/* Bulk functions */
+#define CREATE_INTO_GROUP   0x17
+#define CLEAR_GROUP         0x18
+#define DELETE_SPRITES      0x19
+
+/* Diagnostic functions */
+#define RUN_TIME_STATS      0x1A
+
+/* Most tasks one RUN_TIME_STATS report covers. */
+#define STATS_MAX_TASKS     8
+
+#if STATS_MAX_TASKS * (6 + configMAX_TASK_NAME_LEN) + 4 > 255
+	#error A RUN_TIME_STATS report must fit in one blob
+#endif
+
+/* A trace dump is a TRACE_NAME for each named task and queue, TRACE_RECORDS
+ * blobs of raw trace records, oldest first, then TRACE_END with the number
+ * of records the ring lost. */
+#define TRACE_NAME          0x1B
+#define TRACE_RECORDS       0x1C
+#define TRACE_END           0x1D
+#define TRACE_NAME_TASK     0
+#define TRACE_NAME_QUEUE    1
+#define TRACE_CHUNK_RECORDS 16
+
+/* A create record is the image handle followed by the placement which ends
+ * CREATE_SPRITE_BY_ID. */
+#define CREATE_RECORD_SIZE  12
+
+/* The link starts at BAUD_RATE, then vWindowCreate offers the host each of
+ * baudRates in turn, fastest first. Rates this clock can not produce to within
+ * BAUD_MAX_ERROR tenths of a percent are skipped. */
 #define BAUD_RATE			38400
+#define BAUD_MAX_ERROR      20
+#define BAUD_REPLY_TIMEOUT_MS   500
+#define BAUD_PROBE_TIMEOUT_MS   200
+/* Longer than the host waits for the probe echo and test bytes, so the host
+ * has given up before the confirmation is. */
+#define BAUD_CONFIRM_TIMEOUT_MS 1200
+/* Longer than the host waits for the confirmation, so both ends are back at
+ * BAUD_RATE before the next offer. */
+#define BAUD_RETRY_QUIET_MS     1500
+/* Bytes sent at each new rate for the host to check and time. */
+#define LINK_TEST_LENGTH        255
+
+static const uint32_t baudRates[] = { 1000000, 500000, 250000, 115200, 76800,
+ 57600 };
+
+/* A batch record is the sprite handle followed by one big-endian 32-bit word
+ * holding x (11 bits), y (11 bits) and the angle (10 bits). */
+#define BATCH_RECORD_SIZE   5
+#define BATCH_MAX_RECORDS   50
+#define BATCH_X_MAX         0x07FF
+#define BATCH_Y_MAX         0x07FF
+#define BATCH_ANGLE_MAX     0x03FF
+
+/* A delta record is the sprite handle, a mode byte, and then the position and
+ * rotation fields selected by the mode byte. Nibble deltas pack dx in the high
+ * and dy in the low four bits of a single byte, each from -8 to 7. */
+#define DELTA_POS_NONE      0x00
+#define DELTA_POS_NIBBLE    0x01
+#define DELTA_POS_BYTE      0x02
+#define DELTA_POS_ABS       0x03
+#define DELTA_ROT_NONE      0x00
+#define DELTA_ROT_BYTE      0x04
+#define DELTA_ROT_ABS       0x08
+#define DELTA_MAX_RECORD    8
+
+/* Number of sprites whose last transmitted state is remembered. Sprites are
+ * mapped into the table by handle, so this must be a power of two. */
+#define SHADOW_SIZE         64
+
+typedef struct {
+	xSpriteHandle handle;
+	uint16_t x;
+	uint16_t y;
+	uint16_t angle;
+	uint16_t width;
+	uint16_t height;
+	uint8_t depth;
+} xSpriteShadow;
+
+static xSpriteShadow shadows[SHADOW_SIZE];
+
+/* Requests with a reply are preceded by REQUEST_TAG and a sequence number.
+ * The host answers them with the sequence number, a payload length and the
+ * payload, which the receive interrupt routes to the waiting slot. */
+#define MAX_PENDING         8
+/* Longest a task waits for a reply before its slot is given up. */
+#define REPLY_TIMEOUT_MS    1000
+
+#define PENDING_FREE        0
+#define PENDING_WAITING     1
+#define PENDING_DONE        2
+
+#define RX_SEQ              0
+#define RX_LENGTH           1
+#define RX_PAYLOAD          2
+
+typedef struct {
+	volatile uint8_t state;
+	uint8_t seq;
+	xTaskHandle waiter;
+	xSpriteHandle *results;
+	uint8_t resultsSize;
+	volatile uint8_t count;
+	xSpriteShadow created;
+} xReplySlot;
+
+static xReplySlot replies[MAX_PENDING];
+static uint8_t nextSeq = 0;
+
+static uint8_t rxState = RX_SEQ;
+static uint8_t rxRemaining;
+static xReplySlot *rxSlot;
+
+static uint8_t batchBuffer[BATCH_RECORD_SIZE * BATCH_MAX_RECORDS];
+static uint8_t batchLength = 0;
+static uint8_t batchCommand = SPRITE_BATCH;
+
+static uint8_t prvCopyString(uint8_t *buffer, const char *s, uint8_t max);
+static void prvBatchReserve(uint8_t command, uint8_t length);
+static void prvBatchFlush(void);
+static xSpriteShadow *prvShadowFind(xSpriteHandle sprite);
+static void prvShadowRemember(xSpriteHandle sprite, uint16_t x, uint16_t y,
+ uint16_t angle, uint16_t width, uint16_t height, uint8_t depth);
+static xPendingReply prvReplyIssue(xSpriteHandle *results, uint8_t resultsSize);
+static xReplySlot *prvReplyAwait(xPendingReply pending);
+static portBASE_TYPE prvReplyReceive(uint8_t data);
+static uint32_t prvLinkNegotiate(void);
+static xPendingReply prvSpriteCreateIssue(uint16_t xPos, uint16_t yPos,
+ uint16_t rAngle, uint16_t width, uint16_t height, uint8_t depth);
+static void prvPackPlacement(uint8_t *command, uint16_t xPos, uint16_t yPos,
+ uint16_t rAngle, uint16_t width, uint16_t height, uint8_t depth);
 
 /*******************************************************************************
 * Function: vPrint
 *
 * Description: Prints the supplied string to the python terminal.  Useful for 
-*  debugging.
+*  debugging. Strings longer than PRINT_MAX_LENGTH are cut short.
 *
 * param s: The string to print out.
 *******************************************************************************/
 void vPrint(const char *s) {
-	USART_Write(PYTHON_PRINT);
-	while (*s != '\0') {
-		USART_Write((uint8_t)*s++);
+	uint8_t command[PRINT_MAX_LENGTH + 2];
+	uint8_t length = prvCopyString(&command[1], s, PRINT_MAX_LENGTH);
+	
+	command[0] = PYTHON_PRINT;
+	USART_WriteBlock(command, length + 2);
+}
+
+#if configGENERATE_RUN_TIME_STATS == 1
+
+static xTaskRunTimeType statsTasks[STATS_MAX_TASKS];
+
+static void prvPackLong(uint8_t *buffer, unsigned long value);
+
+/*******************************************************************************
+* Function: vRunTimeStatsReport
+*
+* Description: Sends the run time of every task to the host, which prints each
+*  task's share of the CPU since the last report and since start up. The
+*  payload is the microsecond clock, the number of tickless sleeps taken and
+*  the CPU cycles spent in them, then for each task its priority, its run time
+*  in microseconds and its null-terminated name, all big-endian. Without
+*  configUSE_TICKLESS_IDLE the sleep counts are 0.
+*******************************************************************************/
+void vRunTimeStatsReport(void) {
+	unsigned long total;
+	unsigned long sleeps = 0UL;
+	unsigned long cyclesAsleep = 0UL;
+	uint8_t count, i, length;
+	uint8_t command[14];
+	
+	count = uxTaskGetRunTimeStats(statsTasks, STATS_MAX_TASKS, &total);
+#if configUSE_TICKLESS_IDLE == 1
+	vPortGetSleepStats(&sleeps, &cyclesAsleep);
+#endif
+	
+	length = 12;
+	for (i = 0; i < count; i++) {
+		length += 5 + strlen((const char *)statsTasks[i].pcTaskName) + 1;
+	}
+	
+	command[0] = RUN_TIME_STATS;
+	command[1] = length;
+	prvPackLong(&command[2], total);
+	prvPackLong(&command[6], sleeps);
+	prvPackLong(&command[10], cyclesAsleep);
+	USART_WriteBlock(command, sizeof(command));
+	
+	for (i = 0; i < count; i++) {
+		command[0] = statsTasks[i].uxPriority;
+		prvPackLong(&command[1], statsTasks[i].ulRunTimeCounter);
+		USART_WriteBlock(command, 5);
+		USART_WriteBlock((const uint8_t *)statsTasks[i].pcTaskName,
+		 strlen((const char *)statsTasks[i].pcTaskName) + 1);
+	}
+}
+
+/*******************************************************************************
+* Function: prvPackLong
+*
+* Description: Writes a 32-bit value into a command buffer, big-endian.
+*******************************************************************************/
+static void prvPackLong(uint8_t *buffer, unsigned long value) {
+	buffer[0] = value >> 24;
+	buffer[1] = (value >> 16) & 0xFF;
+	buffer[2] = (value >> 8) & 0xFF;
+	buffer[3] = value & 0xFF;
+}
+
+#endif
+
+#if configUSE_TRACE_RECORDER == 1
+
+static xTraceRecord traceChunk[TRACE_CHUNK_RECORDS];
+
+static void prvTraceName(uint8_t kind, uint8_t number, const char *name) {
+	uint8_t command[3];
+	
+	if (name == NULL)
+	    return;
+	command[0] = TRACE_NAME;
+	command[1] = kind;
+	command[2] = number;
+	USART_WriteBlock(command, sizeof(command));
+	USART_WriteBlock((const uint8_t *)name, strlen(name) + 1);
+}
+
+/*******************************************************************************
+* Function: vTraceReport
+*
+* Description: Sends everything the trace recorder holds to the host, which
+*  prints a summary and draws a timeline of it. Recording must have been
+*  stopped by vTraceTrigger; it stays stopped until vTraceStart. The caller
+*  must hold the link.
+*******************************************************************************/
+void vTraceReport(void) {
+	uint8_t command[3];
+	uint16_t count, lost;
+	uint8_t i;
+	
+	for (i = 0; i < traceMAX_TASKS; i++) {
+		prvTraceName(TRACE_NAME_TASK, i, pcTraceTaskName(i));
+	}
+	for (i = 1; i <= traceMAX_QUEUES; i++) {
+		prvTraceName(TRACE_NAME_QUEUE, i, pcTraceQueueName(i));
+	}
+	
+	while ((count = uTraceRead(traceChunk, TRACE_CHUNK_RECORDS)) > 0) {
+		command[0] = TRACE_RECORDS;
+		command[1] = count * sizeof(xTraceRecord);
+		USART_WriteBlock(command, 2);
+		USART_WriteBlock((const uint8_t *)traceChunk, count * sizeof(xTraceRecord));
 	}
-	USART_Write(0x00);  /* string is null-terminated */
+	
+	lost = uTraceLost();
+	command[0] = TRACE_END;
+	command[1] = lost >> 8;
+	command[2] = lost & 0xFF;
+	USART_WriteBlock(command, sizeof(command));
 }
 
+#endif
+
 /*******************************************************************************
 * Function: vWindowCreate
 *
@@ -47,16 +318,96 @@ void vPrint(const char *s) {
 * param height: Desired height of the window in pixels
 *******************************************************************************/
 void vWindowCreate(uint16_t width, uint16_t height) {
+	uint8_t i;
+	
+	for (i = 0; i < SHADOW_SIZE; i++) {
+		shadows[i].handle = ERROR_HANDLE;
+	}
+	
+	for (i = 0; i < MAX_PENDING; i++) {
+		replies[i].state = PENDING_FREE;
+	}
+	
 	USART_Init(BAUD_RATE, configCPU_CLOCK_HZ);
 
 	USART_Read();
 	USART_Write_Unprotected(0xFF);
 	
+	prvLinkNegotiate();
+	
 	USART_Write_Unprotected(CREATE_WINDOW);
 	USART_Write_Unprotected(width >> 8);
 	USART_Write_Unprotected(width & 0x00FF);
 	USART_Write_Unprotected(height >> 8);
 	USART_Write_Unprotected(height & 0x00FF);
+	
+	/* From here on every reply arrives through the receive interrupt. */
+	USART_SetReceiveHandler(prvReplyReceive);
+}
+
+/*******************************************************************************
+* Function: prvLinkNegotiate
+*
+* Description: Moves the link to the fastest rate in baudRates that both ends
+*  support. For each rate the host is asked whether it can switch; if it agrees,
+*  both ends switch and the host sends a probe. The probe is echoed back,
+*  followed by LINK_TEST_LENGTH test bytes, which the host checks and times.
+*  If they all arrived the host sends LINK_CONFIRM, which is answered with
+*  LINK_CONFIRM, and only then do the two ends keep the new rate. Either end
+*  which times out waiting goes back to BAUD_RATE, and the next rate is tried.
+*  Only a lost reply to LINK_CONFIRM still leaves the ends at different rates.
+*  Must be called before the receive handler is installed.
+*
+* return: The rate the link is left at
+*******************************************************************************/
+static uint32_t prvLinkNegotiate(void) {
+	uint8_t i;
+	uint16_t offer, j;
+	int16_t answer;
+	
+	for (i = 0; i < sizeof(baudRates) / sizeof(baudRates[0]); i++) {
+		if (USART_BaudError(baudRates[i], configCPU_CLOCK_HZ) > BAUD_MAX_ERROR) {
+			continue;
+		}
+		
+		/* rates are sent in hundreds of baud */
+		offer = baudRates[i] / 100;
+		USART_Write_Unprotected(NEGOTIATE_BAUD);
+		USART_Write_Unprotected(offer >> 8);
+		USART_Write_Unprotected(offer & 0x00FF);
+		
+		answer = USART_ReadTimeout(BAUD_REPLY_TIMEOUT_MS);
+		if (answer < 0) {
+			/* the host does not negotiate */
+			break;
+		} else if (answer == 0) {
+			continue;
+		}
+		
+		USART_Init(baudRates[i], configCPU_CLOCK_HZ);
+		if (USART_ReadTimeout(BAUD_PROBE_TIMEOUT_MS) == LINK_PROBE &&
+		 USART_ReadTimeout(BAUD_PROBE_TIMEOUT_MS) == LINK_PROBE_PATTERN) {
+			USART_Write_Unprotected(LINK_PROBE);
+			USART_Write_Unprotected(LINK_PROBE_PATTERN);
+			USART_Write_Unprotected(LINK_TEST);
+			USART_Write_Unprotected(LINK_TEST_LENGTH);
+			for (j = 0; j < LINK_TEST_LENGTH; j++) {
+				USART_Write_Unprotected(j);
+			}
+			
+			if (USART_ReadTimeout(BAUD_CONFIRM_TIMEOUT_MS) == LINK_CONFIRM) {
+				USART_Write_Unprotected(LINK_CONFIRM);
+				return baudRates[i];
+			}
+		}
+		
+		/* fall back, and throw away anything garbled until the host has too */
+		USART_Init(BAUD_RATE, configCPU_CLOCK_HZ);
+		while (USART_ReadTimeout(BAUD_RETRY_QUIET_MS) >= 0)
+			;
+	}
+	
+	return BAUD_RATE;
 }
 
 /*******************************************************************************
@@ -64,10 +415,11 @@ void vWindowCreate(uint16_t width, uint16_t height) {
 *
 * Description: Instantiates a sprite in the external graphics context using the
 *  contents of the given external file with the given position, angle, size, and
-*  depth in the window. The window origin is in the upper-left corner.
+*  depth in the window. The window origin is in the upper-left corner. Blocks
+*  until the external graphics context replies; see xSpriteCreateAsync.
 *
 * param filename: Null-terminated string containing the name of the sprite image
-*  file in the external graphics context.
+*  file in the external graphics context, at most IMAGE_NAME_MAX characters.
 * param xPos: Initial x-position of the center of the sprite in window coords
 * param yPos: Initial y-position of the center of the sprite in window coords
 * param rAngle: Initial CCW rotation of the sprite about its center in degrees
@@ -78,29 +430,163 @@ void vWindowCreate(uint16_t width, uint16_t height) {
 *******************************************************************************/
 xSpriteHandle xSpriteCreate(const char *filename, uint16_t xPos, uint16_t yPos,
  uint16_t rAngle, uint16_t width, uint16_t height, uint8_t depth) {
+	return xSpriteAwait(xSpriteCreateAsync(filename, xPos, yPos, rAngle,
+	 width, height, depth));
+}
+
+/*******************************************************************************
+* Function: xSpriteCreateAsync
+*
+* Description: Sends a sprite creation request (see xSpriteCreate) without
+*  waiting for its reply. The new handle is collected later with xSpriteAwait,
+*  which must be called exactly once for every pending reply returned.
+*
+* return: A pending reply on success; ERROR_PENDING if too many replies are
+*  already outstanding or the filename is longer than IMAGE_NAME_MAX
+*******************************************************************************/
+xPendingReply xSpriteCreateAsync(const char *filename, uint16_t xPos,
+ uint16_t yPos, uint16_t rAngle, uint16_t width, uint16_t height,
+ uint8_t depth) {
+	xPendingReply pending;
+	uint8_t command[1 + IMAGE_NAME_MAX + 1 + 11];
+	uint8_t length;
+	
+	if (strlen(filename) > IMAGE_NAME_MAX) {
+		return ERROR_PENDING;
+	}
+	pending = prvSpriteCreateIssue(xPos, yPos, rAngle, width, height, depth);
+	if (pending == ERROR_PENDING) {
+		return ERROR_PENDING;
+	}
 	
-	USART_Write(CREATE_SPRITE);
+	command[0] = CREATE_SPRITE;
+	/* Filename is null-terminated */
+	length = 1 + prvCopyString(&command[1], filename, IMAGE_NAME_MAX) + 1;
+	prvPackPlacement(&command[length], xPos, yPos, rAngle, width, height, depth);
+	USART_WriteBlock(command, length + 11);
+	
+	return pending;
+}
 
-	while (*filename != '\0') {
-		USART_Write((uint8_t)*filename++);
+/*******************************************************************************
+* Function: xImageRegister
+*
+* Description: Loads an image file in the external graphics context once and
+*  names it with a one-byte handle, so sprites can be created from it with
+*  xSpriteCreateById instead of sending the filename every time. Registering
+*  the same file again returns the same handle. Blocks until the external
+*  graphics context replies.
+*
+* param filename: Null-terminated string containing the name of the image file
+*  in the external graphics context, at most IMAGE_NAME_MAX characters.
+* return: A valid handle to the image on success; ERROR_HANDLE otherwise
+*******************************************************************************/
+xImageHandle xImageRegister(const char *filename) {
+	xPendingReply pending;
+	xReplySlot *slot;
+	xImageHandle result;
+	uint8_t command[1 + IMAGE_NAME_MAX + 1];
+	uint8_t length;
+	
+	if (strlen(filename) > IMAGE_NAME_MAX) {
+		return ERROR_HANDLE;
+	}
+	pending = prvReplyIssue(NULL, 0);
+	if (pending == ERROR_PENDING) {
+		return ERROR_HANDLE;
+	}
+	slot = &replies[pending];
+	slot->results = &slot->created.handle;
+	slot->resultsSize = 1;
+	
+	command[0] = REGISTER_IMAGE;
+	length = prvCopyString(&command[1], filename, IMAGE_NAME_MAX);
+	USART_WriteBlock(command, length + 2);
+	
+	if (prvReplyAwait(pending) == NULL) {
+		return ERROR_HANDLE;
 	}
-	USART_Write(0x00);  /* Filename is null-terminated */
+	result = slot->count > 0 ? slot->created.handle : ERROR_HANDLE;
+	slot->state = PENDING_FREE;
+	
+	return result;
+}
+
+/*******************************************************************************
+* Function: xSpriteCreateById
+*
+* Description: Instantiates a sprite as xSpriteCreate does, from an image
+*  registered with xImageRegister. Blocks until the external graphics context
+*  replies; see xSpriteCreateByIdAsync.
+*
+* param image: The handle to the registered image
+* return: A valid handle to the new sprite on success; ERROR_HANDLE otherwise
+*******************************************************************************/
+xSpriteHandle xSpriteCreateById(xImageHandle image, uint16_t xPos,
+ uint16_t yPos, uint16_t rAngle, uint16_t width, uint16_t height,
+ uint8_t depth) {
+	return xSpriteAwait(xSpriteCreateByIdAsync(image, xPos, yPos, rAngle,
+	 width, height, depth));
+}
 
-	USART_Write(xPos >> 8);
-	USART_Write(xPos & 0x00FF);
-	USART_Write(yPos >> 8);
-	USART_Write(yPos & 0x00FF);
-	USART_Write(rAngle >> 8);
-	USART_Write(rAngle & 0x00FF);
-	USART_Write(width >> 8);
-	USART_Write(width & 0x00FF);
-	USART_Write(height >> 8);
-	USART_Write(height & 0x00FF);
-	USART_Write(depth);
+/*******************************************************************************
+* Function: xSpriteCreateByIdAsync
+*
+* Description: Sends a sprite creation request (see xSpriteCreateById) without
+*  waiting for its reply, which is collected later with xSpriteAwait.
+*
+* return: A pending reply on success; ERROR_PENDING if too many replies are
+*  already outstanding
+*******************************************************************************/
+xPendingReply xSpriteCreateByIdAsync(xImageHandle image, uint16_t xPos,
+ uint16_t yPos, uint16_t rAngle, uint16_t width, uint16_t height,
+ uint8_t depth) {
+	xPendingReply pending;
+	uint8_t command[13];
+	
+	pending = prvSpriteCreateIssue(xPos, yPos, rAngle, width, height, depth);
+	if (pending == ERROR_PENDING) {
+		return ERROR_PENDING;
+	}
+	
+	command[0] = CREATE_SPRITE_BY_ID;
+	command[1] = image;
+	prvPackPlacement(&command[2], xPos, yPos, rAngle, width, height, depth);
+	USART_WriteBlock(command, sizeof(command));
+	
+	return pending;
+}
+
+/*******************************************************************************
+* Function: xSpriteAwait
+*
+* Description: Blocks until the reply to a sprite creation request arrives, or
+*  for at most REPLY_TIMEOUT_MS.
+*
+* param pending: The pending reply returned by xSpriteCreateAsync
+* return: A valid handle to the new sprite on success; ERROR_HANDLE otherwise,
+*  or if no reply came in time
+*******************************************************************************/
+xSpriteHandle xSpriteAwait(xPendingReply pending) {
+	xReplySlot *slot;
+	xSpriteShadow *created;
+	xSpriteHandle result;
 	
-	PORTA = 0xAA;
-	xSpriteHandle result = (xSpriteHandle)USART_Read();
-	PORTA = 0xFF;
+	if (pending == ERROR_PENDING) {
+		return ERROR_HANDLE;
+	}
+	
+	slot = prvReplyAwait(pending);
+	if (slot == NULL) {
+		return ERROR_HANDLE;
+	}
+	created = &slot->created;
+	result = slot->count > 0 ? created->handle : ERROR_HANDLE;
+	if (result != ERROR_HANDLE) {
+		prvShadowRemember(result, created->x, created->y, created->angle,
+		 created->width, created->height, created->depth);
+	}
+	slot->state = PENDING_FREE;
 	
 	return result;
 }
@@ -116,12 +602,27 @@ xSpriteHandle xSpriteCreate(const char *filename, uint16_t xPos, uint16_t yPos,
 * param y: New y-position of the sprite's center in window coordinates
 *******************************************************************************/
 void vSpriteSetPosition(xSpriteHandle sprite, uint16_t x, uint16_t y) {
-	USART_Write(SET_POS);
-	USART_Write(sprite);
-	USART_Write(x >> 8);
-	USART_Write(x & 0x00FF);
-	USART_Write(y >> 8);
-	USART_Write(y & 0x00FF);
+	xSpriteShadow *shadow = prvShadowFind(sprite);
+	uint8_t command[6];
+	
+	/* Inside a frame, the host applies this after the transforms before it. */
+	prvBatchFlush();
+	
+	if (shadow != NULL) {
+		if (shadow->x == x && shadow->y == y) {
+			return;
+		}
+		shadow->x = x;
+		shadow->y = y;
+	}
+	
+	command[0] = SET_POS;
+	command[1] = sprite;
+	command[2] = x >> 8;
+	command[3] = x & 0x00FF;
+	command[4] = y >> 8;
+	command[5] = y & 0x00FF;
+	USART_WriteBlock(command, sizeof(command));
 }
 
 /*******************************************************************************
@@ -133,10 +634,23 @@ void vSpriteSetPosition(xSpriteHandle sprite, uint16_t x, uint16_t y) {
 * param angle: Angle in degrees to rotate the sprite CCW about its center
 *******************************************************************************/
 void vSpriteSetRotation(xSpriteHandle sprite, uint16_t angle) {
-	USART_Write(SET_ROT);
-	USART_Write(sprite);
-	USART_Write(angle >> 8);
-	USART_Write(angle & 0x00FF);
+	xSpriteShadow *shadow = prvShadowFind(sprite);
+	uint8_t command[4];
+	
+	prvBatchFlush();
+	
+	if (shadow != NULL) {
+		if (shadow->angle == angle) {
+			return;
+		}
+		shadow->angle = angle;
+	}
+	
+	command[0] = SET_ROT;
+	command[1] = sprite;
+	command[2] = angle >> 8;
+	command[3] = angle & 0x00FF;
+	USART_WriteBlock(command, sizeof(command));
 }
 
 /*******************************************************************************
@@ -149,12 +663,24 @@ void vSpriteSetRotation(xSpriteHandle sprite, uint16_t angle) {
 * param height: New height of the sprite in pixels before applying rotation
 *******************************************************************************/
 void vSpriteSetSize(xSpriteHandle sprite, uint16_t width, uint16_t height) {
-	USART_Write(SET_SIZE);
-	USART_Write(sprite);
-	USART_Write(width >> 8);
-	USART_Write(width & 0x00FF);
-	USART_Write(height >> 8);
-	USART_Write(height & 0x00FF);
+	xSpriteShadow *shadow = prvShadowFind(sprite);
+	uint8_t command[6];
+	
+	if (shadow != NULL) {
+		if (shadow->width == width && shadow->height == height) {
+			return;
+		}
+		shadow->width = width;
+		shadow->height = height;
+	}
+	
+	command[0] = SET_SIZE;
+	command[1] = sprite;
+	command[2] = width >> 8;
+	command[3] = width & 0x00FF;
+	command[4] = height >> 8;
+	command[5] = height & 0x00FF;
+	USART_WriteBlock(command, sizeof(command));
 }
 
 /*******************************************************************************
@@ -166,9 +692,20 @@ void vSpriteSetSize(xSpriteHandle sprite, uint16_t width, uint16_t height) {
 * param depth: New draw depth (larger depths are in front of smaller depths)
 *******************************************************************************/
 void vSpriteSetDepth(xSpriteHandle sprite, uint8_t depth) {
-	USART_Write(SET_ORDER);
-	USART_Write(sprite);
-	USART_Write(depth);
+	xSpriteShadow *shadow = prvShadowFind(sprite);
+	uint8_t command[3];
+	
+	if (shadow != NULL) {
+		if (shadow->depth == depth) {
+			return;
+		}
+		shadow->depth = depth;
+	}
+	
+	command[0] = SET_ORDER;
+	command[1] = sprite;
+	command[2] = depth;
+	USART_WriteBlock(command, sizeof(command));
 }
 
 /*******************************************************************************
@@ -180,8 +717,127 @@ void vSpriteSetDepth(xSpriteHandle sprite, uint8_t depth) {
 * param sprite: The handle to the sprite to be deleted
 *******************************************************************************/
 void vSpriteDelete(xSpriteHandle sprite) {
-	USART_Write(DELETE_SPRITE);
-	USART_Write(sprite);
+	xSpriteShadow *shadow = prvShadowFind(sprite);
+	uint8_t command[2];
+	
+	if (shadow != NULL) {
+		shadow->handle = ERROR_HANDLE;
+	}
+	
+	command[0] = DELETE_SPRITE;
+	command[1] = sprite;
+	USART_WriteBlock(command, sizeof(command));
+}
+
+/*******************************************************************************
+* Function: uSpriteCreateBatch
+*
+* Description: Creates several sprites from registered images and adds them to
+*  a group, in one message with one reply. Blocks until the external graphics
+*  context replies.
+*
+* param group: The group to add the new sprites to, or ALL_GROUP for none
+* param specs: The image and placement of each sprite
+* param count: The number of sprites to create, at most SPRITE_BATCH_MAX
+* param handles: Receives the handle of each new sprite, or ERROR_HANDLE for
+*  each one which could not be created
+* return: The number of sprites created
+*******************************************************************************/
+uint8_t uSpriteCreateBatch(xGroupHandle group, const xSpriteSpec specs[],
+ uint8_t count, xSpriteHandle handles[]) {
+	xPendingReply pending;
+	xReplySlot *slot;
+	uint8_t command[3];
+	uint8_t record[CREATE_RECORD_SIZE];
+	uint8_t i, replied, created = 0;
+	
+	if (count > SPRITE_BATCH_MAX) {
+		count = SPRITE_BATCH_MAX;
+	}
+	
+	pending = prvReplyIssue(handles, count);
+	if (pending == ERROR_PENDING) {
+		replied = 0;
+	} else {
+		command[0] = CREATE_INTO_GROUP;
+		command[1] = group;
+		command[2] = count * CREATE_RECORD_SIZE;
+		USART_WriteBlock(command, sizeof(command));
+		
+		for (i = 0; i < count; i++) {
+			record[0] = specs[i].image;
+			prvPackPlacement(&record[1], specs[i].x, specs[i].y, specs[i].angle,
+			 specs[i].width, specs[i].height, specs[i].depth);
+			USART_WriteBlock(record, sizeof(record));
+		}
+		
+		slot = prvReplyAwait(pending);
+		if (slot == NULL) {
+			replied = 0;
+		} else {
+			replied = slot->count < count ? slot->count : count;
+			slot->state = PENDING_FREE;
+		}
+	}
+	
+	for (i = 0; i < count; i++) {
+		if (i >= replied) {
+			handles[i] = ERROR_HANDLE;
+		} else if (handles[i] != ERROR_HANDLE) {
+			prvShadowRemember(handles[i], specs[i].x, specs[i].y, specs[i].angle,
+			 specs[i].width, specs[i].height, specs[i].depth);
+			created++;
+		}
+	}
+	
+	return created;
+}
+
+/*******************************************************************************
+* Function: uSpriteDeleteList
+*
+* Description: Deletes several sprites in one message with one reply. Blocks
+*  until the external graphics context replies.
+*
+* param handles: The handles to the sprites to delete
+* param count: The number of handles
+* return: The number of sprites deleted; handles which were not valid are
+*  skipped
+*******************************************************************************/
+uint8_t uSpriteDeleteList(const xSpriteHandle handles[], uint8_t count) {
+	xPendingReply pending;
+	xReplySlot *slot;
+	xSpriteShadow *shadow;
+	uint8_t command[2];
+	uint8_t i, deleted;
+	
+	for (i = 0; i < count; i++) {
+		shadow = prvShadowFind(handles[i]);
+		if (shadow != NULL) {
+			shadow->handle = ERROR_HANDLE;
+		}
+	}
+	
+	pending = prvReplyIssue(NULL, 0);
+	if (pending == ERROR_PENDING) {
+		return 0;
+	}
+	slot = &replies[pending];
+	slot->results = &slot->created.handle;
+	slot->resultsSize = 1;
+	
+	command[0] = DELETE_SPRITES;
+	command[1] = count;
+	USART_WriteBlock(command, sizeof(command));
+	USART_WriteBlock(handles, count);
+	
+	if (prvReplyAwait(pending) == NULL) {
+		return 0;
+	}
+	deleted = slot->count > 0 ? slot->created.handle : 0;
+	slot->state = PENDING_FREE;
+	
+	return deleted;
 }
 
 /*******************************************************************************
@@ -193,8 +849,55 @@ void vSpriteDelete(xSpriteHandle sprite) {
 * return: A valid handle to the new group on success; ERROR_HANDLE otherwise
 *******************************************************************************/
 xGroupHandle xGroupCreate(void) {
-	USART_Write(CREATE_GROUP);
-	xGroupHandle result = (xGroupHandle)USART_Read();
+	return xGroupAwait(xGroupCreateAsync());
+}
+
+/*******************************************************************************
+* Function: xGroupCreateAsync
+*
+* Description: Sends a group creation request (see xGroupCreate) without
+*  waiting for its reply, which is collected later with xGroupAwait.
+*
+* return: A pending reply on success; ERROR_PENDING if too many replies are
+*  already outstanding
+*******************************************************************************/
+xPendingReply xGroupCreateAsync(void) {
+	xPendingReply pending;
+	
+	pending = prvReplyIssue(NULL, 0);
+	if (pending != ERROR_PENDING) {
+		replies[pending].results = &replies[pending].created.handle;
+		replies[pending].resultsSize = 1;
+		USART_Write(CREATE_GROUP);
+	}
+	
+	return pending;
+}
+
+/*******************************************************************************
+* Function: xGroupAwait
+*
+* Description: Blocks until the reply to a group creation request arrives, or
+*  for at most REPLY_TIMEOUT_MS.
+*
+* param pending: The pending reply returned by xGroupCreateAsync
+* return: A valid handle to the new group on success; ERROR_HANDLE otherwise,
+*  or if no reply came in time
+*******************************************************************************/
+xGroupHandle xGroupAwait(xPendingReply pending) {
+	xReplySlot *slot;
+	xGroupHandle result;
+	
+	if (pending == ERROR_PENDING) {
+		return ERROR_HANDLE;
+	}
+	
+	slot = prvReplyAwait(pending);
+	if (slot == NULL) {
+		return ERROR_HANDLE;
+	}
+	result = slot->count > 0 ? slot->created.handle : ERROR_HANDLE;
+	slot->state = PENDING_FREE;
 	
 	return result;
 }
@@ -208,9 +911,12 @@ xGroupHandle xGroupCreate(void) {
 * param sprite: The handle to the sprite to add to the group
 *******************************************************************************/
 void vGroupAddSprite(xGroupHandle group, xSpriteHandle sprite) {
-	USART_Write(ADD_TO_GROUP);
-	USART_Write(group);
-	USART_Write(sprite);
+	uint8_t command[3];
+	
+	command[0] = ADD_TO_GROUP;
+	command[1] = group;
+	command[2] = sprite;
+	USART_WriteBlock(command, sizeof(command));
 }
 
 /*******************************************************************************
@@ -222,9 +928,12 @@ void vGroupAddSprite(xGroupHandle group, xSpriteHandle sprite) {
 * param sprite: The handle to the sprite to remove from the group
 *******************************************************************************/
 void vGroupRemoveSprite(xGroupHandle group, xSpriteHandle sprite) {
-	USART_Write(REMOVE_FROM_GROUP);
-	USART_Write(group);
-	USART_Write(sprite);
+	uint8_t command[3];
+	
+	command[0] = REMOVE_FROM_GROUP;
+	command[1] = group;
+	command[2] = sprite;
+	USART_WriteBlock(command, sizeof(command));
 }
 
 /*******************************************************************************
@@ -236,8 +945,56 @@ void vGroupRemoveSprite(xGroupHandle group, xSpriteHandle sprite) {
 * param group: The handle to the group to be deleted
 *******************************************************************************/
 void vGroupDelete(xGroupHandle group) {
-	USART_Write(DELETE_GROUP);
-	USART_Write(group);
+	uint8_t command[2];
+	
+	command[0] = DELETE_GROUP;
+	command[1] = group;
+	USART_WriteBlock(command, sizeof(command));
+}
+
+/*******************************************************************************
+* Function: uGroupClear
+*
+* Description: Deletes every sprite in the given group, in one message with one
+*  reply. The group itself stays valid and empty. Clearing ALL_GROUP deletes
+*  every sprite. Blocks until the external graphics context replies.
+*
+* param group: The handle to the group to clear
+* return: The number of sprites deleted
+*******************************************************************************/
+uint8_t uGroupClear(xGroupHandle group) {
+	xPendingReply pending;
+	xReplySlot *slot;
+	uint8_t command[2];
+	uint8_t i, deleted;
+	
+	/* Only the host knows which sprites are in other groups, so their shadows
+	 * are left to be replaced when the handles are reused. */
+	if (group == ALL_GROUP) {
+		for (i = 0; i < SHADOW_SIZE; i++) {
+			shadows[i].handle = ERROR_HANDLE;
+		}
+	}
+	
+	pending = prvReplyIssue(NULL, 0);
+	if (pending == ERROR_PENDING) {
+		return 0;
+	}
+	slot = &replies[pending];
+	slot->results = &slot->created.handle;
+	slot->resultsSize = 1;
+	
+	command[0] = CLEAR_GROUP;
+	command[1] = group;
+	USART_WriteBlock(command, sizeof(command));
+	
+	if (prvReplyAwait(pending) == NULL) {
+		return 0;
+	}
+	deleted = slot->count > 0 ? slot->created.handle : 0;
+	slot->state = PENDING_FREE;
+	
+	return deleted;
 }
 
 /*******************************************************************************
@@ -245,7 +1002,8 @@ void vGroupDelete(xGroupHandle group) {
 *
 * Description: Tests if the given sprite collided with any members of the given
 *  group and populates the provided hits array with sprite handles the sprite
-*  collided with.
+*  collided with. Blocks until the external graphics context replies; see
+*  xCollideAsync.
 *
 * param sprite: The handle to the sprite to test for collisions
 * param group: The handle to the group of sprites to test for collisions
@@ -257,22 +1015,470 @@ void vGroupDelete(xGroupHandle group) {
 *******************************************************************************/
 uint8_t uCollide(xSpriteHandle sprite, xGroupHandle group,
  xSpriteHandle hits[], uint8_t hitsSize) {
-	uint8_t hitCount = 0;
+	return uCollideAwait(xCollideAsync(sprite, group, hits, hitsSize));
+}
+
+/*******************************************************************************
+* Function: xCollideAsync
+*
+* Description: Sends a collision test (see uCollide) without waiting for its
+*  reply, so that several tests can be in flight at once. The hits array is
+*  filled in by the receive interrupt and must stay valid until the result is
+*  collected with uCollideAwait.
+*
+* return: A pending reply on success; ERROR_PENDING if too many replies are
+*  already outstanding
+*******************************************************************************/
+xPendingReply xCollideAsync(xSpriteHandle sprite, xGroupHandle group,
+ xSpriteHandle hits[], uint8_t hitsSize) {
+	xPendingReply pending;
+	uint8_t command[3];
+	
+	pending = prvReplyIssue(hits, hitsSize);
+	if (pending != ERROR_PENDING) {
+		command[0] = COLLIDE;
+		command[1] = sprite;
+		command[2] = group;
+		USART_WriteBlock(command, sizeof(command));
+	}
+	
+	return pending;
+}
+
+/*******************************************************************************
+* Function: uCollideAwait
+*
+* Description: Blocks until the reply to a collision test arrives, or for at
+*  most REPLY_TIMEOUT_MS.
+*
+* param pending: The pending reply returned by xCollideAsync
+* return: The number of sprites the tested sprite collided with, which may be
+*  larger than the number stored in the hits array; 0 if no reply came in time
+*******************************************************************************/
+uint8_t uCollideAwait(xPendingReply pending) {
+	xReplySlot *slot;
+	uint8_t hitCount;
 	
-	USART_Write(COLLIDE);
-	USART_Write(sprite);
-	USART_Write(group);
+	if (pending == ERROR_PENDING) {
+		return 0;
+	}
+	
+	slot = prvReplyAwait(pending);
+	if (slot == NULL) {
+		return 0;
+	}
+	hitCount = slot->count;
+	slot->state = PENDING_FREE;
 	
-	while (hitCount < hitsSize) {
-		hits[hitCount] = USART_Read();
-		if (hits[hitCount] == ERROR_HANDLE) {
-			return hitCount;
+	return hitCount;
+}
+
+/*******************************************************************************
+* Function: vFrameBegin
+*
+* Description: Opens a frame in the external graphics context. Transforms
+*  queued with vSpriteBatchTransform, and positions and rotations set with
+*  vSpriteSetPosition and vSpriteSetRotation, are held by the external
+*  graphics context until vFrameEnd is called. They are then applied to the
+*  window all at once, in the order they were made, so a delta is always
+*  resolved against the position or rotation set before it.
+*******************************************************************************/
+void vFrameBegin(void) {
+	batchLength = 0;
+	USART_Write(BEGIN_FRAME);
+}
+
+/*******************************************************************************
+* Function: vSpriteBatchTransform
+*
+* Description: Queues a new position and rotation for the given sprite in the
+*  current frame. Only the fields which changed since they were last sent are
+*  transmitted, as signed deltas when the change is small. A sprite which did
+*  not move or turn costs nothing. Sprites without a shadow entry are sent as
+*  packed 5-byte SPRITE_BATCH records, and values which do not fit the packed
+*  record are sent as a SET_POS and SET_ROT pair instead.
+*
+* param sprite: The handle to the sprite
+* param x: New x-position of the sprite's center in window coordinates
+* param y: New y-position of the sprite's center in window coordinates
+* param angle: Angle in degrees to rotate the sprite CCW about its center
+*******************************************************************************/
+void vSpriteBatchTransform(xSpriteHandle sprite, uint16_t x, uint16_t y,
+ uint16_t angle) {
+	xSpriteShadow *shadow = prvShadowFind(sprite);
+	uint8_t record[DELTA_MAX_RECORD];
+	uint8_t length = 2;
+	uint8_t mode;
+	int16_t dx, dy, dAngle;
+	
+	if (shadow != NULL) {
+		dx = (int16_t)(x - shadow->x);
+		dy = (int16_t)(y - shadow->y);
+		dAngle = (int16_t)(angle - shadow->angle);
+		
+		if (dx == 0 && dy == 0) {
+			mode = DELTA_POS_NONE;
+		} else if (dx >= -8 && dx <= 7 && dy >= -8 && dy <= 7) {
+			mode = DELTA_POS_NIBBLE;
+			record[length++] = ((uint8_t)dx << 4) | ((uint8_t)dy & 0x0F);
+		} else if (dx >= -128 && dx <= 127 && dy >= -128 && dy <= 127) {
+			mode = DELTA_POS_BYTE;
+			record[length++] = (uint8_t)dx;
+			record[length++] = (uint8_t)dy;
+		} else {
+			mode = DELTA_POS_ABS;
+			record[length++] = x >> 8;
+			record[length++] = x & 0x00FF;
+			record[length++] = y >> 8;
+			record[length++] = y & 0x00FF;
+		}
+		
+		if (dAngle == 0) {
+			mode |= DELTA_ROT_NONE;
+		} else if (dAngle >= -128 && dAngle <= 127) {
+			mode |= DELTA_ROT_BYTE;
+			record[length++] = (uint8_t)dAngle;
+		} else {
+			mode |= DELTA_ROT_ABS;
+			record[length++] = angle >> 8;
+			record[length++] = angle & 0x00FF;
+		}
+		
+		if (mode == (DELTA_POS_NONE | DELTA_ROT_NONE)) {
+			return;
 		}
-		hitCount++;
+		
+		record[0] = sprite;
+		record[1] = mode;
+		prvBatchReserve(SPRITE_DELTA, length);
+		memcpy(&batchBuffer[batchLength], record, length);
+		batchLength += length;
+		
+		shadow->x = x;
+		shadow->y = y;
+		shadow->angle = angle;
+		return;
 	}
 	
-	while (USART_Read() != ERROR_HANDLE)
-	    hitCount++;
+	if (x > BATCH_X_MAX || y > BATCH_Y_MAX || angle > BATCH_ANGLE_MAX) {
+		vSpriteSetPosition(sprite, x, y);
+		vSpriteSetRotation(sprite, angle);
+		return;
+	}
+	
+	prvBatchReserve(SPRITE_BATCH, BATCH_RECORD_SIZE);
+	record[0] = sprite;
+	record[1] = x >> 3;
+	record[2] = (x << 5) | (y >> 6);
+	record[3] = (y << 2) | (angle >> 8);
+	record[4] = angle & 0x00FF;
+	memcpy(&batchBuffer[batchLength], record, BATCH_RECORD_SIZE);
+	batchLength += BATCH_RECORD_SIZE;
+}
+
+/*******************************************************************************
+* Function: vFrameEnd
+*
+* Description: Sends any transforms still queued for the current frame and
+*  closes the frame, at which point the external graphics context applies
+*  every transform of the frame atomically.
+*******************************************************************************/
+void vFrameEnd(void) {
+	prvBatchFlush();
+	USART_Write(END_FRAME);
+}
+
+/*******************************************************************************
+* Function: prvBatchReserve
+*
+* Description: Makes room in the batch buffer for a record of the given command
+*  type, flushing the buffer first if it is full or holds the other type.
+*
+* param command: SPRITE_BATCH or SPRITE_DELTA
+* param length: Size of the record to be appended in bytes
+*******************************************************************************/
+static void prvBatchReserve(uint8_t command, uint8_t length) {
+	if (batchCommand != command ||
+	 batchLength + length > sizeof(batchBuffer)) {
+		prvBatchFlush();
+		batchCommand = command;
+	}
+}
+
+/*******************************************************************************
+* Function: prvBatchFlush
+*
+* Description: Sends the queued records as a single SPRITE_BATCH or
+*  SPRITE_DELTA command whose payload is prefixed with its length in bytes.
+*******************************************************************************/
+static void prvBatchFlush(void) {
+	uint8_t header[2];
+	
+	if (batchLength == 0) {
+		return;
+	}
+	
+	header[0] = batchCommand;
+	header[1] = batchLength;
+	USART_WriteBlock(header, sizeof(header));
+	USART_WriteBlock(batchBuffer, batchLength);
+	batchLength = 0;
+}
+
+/*******************************************************************************
+* Function: prvShadowFind
+*
+* Description: Looks up the last transmitted state of the given sprite.
+*
+* param sprite: The handle to the sprite
+* return: The sprite's shadow entry, or NULL if it has none
+*******************************************************************************/
+static xSpriteShadow *prvShadowFind(xSpriteHandle sprite) {
+	xSpriteShadow *shadow = &shadows[sprite & (SHADOW_SIZE - 1)];
+	
+	if (sprite == ERROR_HANDLE || shadow->handle != sprite) {
+		return NULL;
+	}
+	return shadow;
+}
+
+/*******************************************************************************
+* Function: prvShadowRemember
+*
+* Description: Records the state of a newly created sprite, evicting whichever
+*  sprite previously occupied its shadow entry. An evicted sprite is simply
+*  sent in full from then on.
+*******************************************************************************/
+static void prvShadowRemember(xSpriteHandle sprite, uint16_t x, uint16_t y,
+ uint16_t angle, uint16_t width, uint16_t height, uint8_t depth) {
+	xSpriteShadow *shadow = &shadows[sprite & (SHADOW_SIZE - 1)];
+	
+	shadow->handle = sprite;
+	shadow->x = x;
+	shadow->y = y;
+	shadow->angle = angle;
+	shadow->width = width;
+	shadow->height = height;
+	shadow->depth = depth;
+}
+
+/*******************************************************************************
+* Function: prvReplyIssue
+*
+* Description: Claims a reply slot and sends the REQUEST_TAG which tells the
+*  host to answer the next command with a tagged reply. The slot is claimed
+*  before anything is sent so that even a fast reply finds it waiting.
+*
+* param results: Where the receive interrupt stores the reply payload
+* param resultsSize: The number of payload bytes which fit in results
+* return: The claimed slot; ERROR_PENDING if every slot is in use
+*******************************************************************************/
+static xPendingReply prvReplyIssue(xSpriteHandle *results, uint8_t resultsSize) {
+	xPendingReply pending;
+	xReplySlot *slot = NULL;
+	uint8_t command[2];
+	
+	portENTER_CRITICAL();
+	for (pending = 0; pending < MAX_PENDING; pending++) {
+		if (replies[pending].state == PENDING_FREE) {
+			slot = &replies[pending];
+			slot->results = results;
+			slot->resultsSize = resultsSize;
+			slot->count = 0;
+			slot->waiter = NULL;
+			slot->seq = nextSeq++;
+			slot->state = PENDING_WAITING;
+			break;
+		}
+	}
+	portEXIT_CRITICAL();
+	
+	if (slot == NULL) {
+		return ERROR_PENDING;
+	}
+	
+	command[0] = REQUEST_TAG;
+	command[1] = slot->seq;
+	USART_WriteBlock(command, sizeof(command));
+	
+	return pending;
+}
+
+/*******************************************************************************
+* Function: prvSpriteCreateIssue
+*
+* Description: Claims a reply slot for a sprite creation request and remembers
+*  the new sprite's placement, so the shadow can be seeded once the handle is
+*  known. The reply cannot arrive before the caller has sent the command.
+*
+* return: The claimed slot; ERROR_PENDING if every slot is in use
+*******************************************************************************/
+static xPendingReply prvSpriteCreateIssue(uint16_t xPos, uint16_t yPos,
+ uint16_t rAngle, uint16_t width, uint16_t height, uint8_t depth) {
+	xPendingReply pending;
+	xSpriteShadow *created;
+	
+	pending = prvReplyIssue(NULL, 0);
+	if (pending == ERROR_PENDING) {
+		return ERROR_PENDING;
+	}
+	
+	created = &replies[pending].created;
+	created->handle = ERROR_HANDLE;
+	created->x = xPos;
+	created->y = yPos;
+	created->angle = rAngle;
+	created->width = width;
+	created->height = height;
+	created->depth = depth;
+	replies[pending].results = &created->handle;
+	replies[pending].resultsSize = 1;
+	
+	return pending;
+}
+
+/*******************************************************************************
+* Function: prvPackPlacement
+*
+* Description: Writes the 11 bytes of position, angle, size and depth which end
+*  both sprite creation commands.
+*******************************************************************************/
+static void prvPackPlacement(uint8_t *command, uint16_t xPos, uint16_t yPos,
+ uint16_t rAngle, uint16_t width, uint16_t height, uint8_t depth) {
+	command[0] = xPos >> 8;
+	command[1] = xPos & 0x00FF;
+	command[2] = yPos >> 8;
+	command[3] = yPos & 0x00FF;
+	command[4] = rAngle >> 8;
+	command[5] = rAngle & 0x00FF;
+	command[6] = width >> 8;
+	command[7] = width & 0x00FF;
+	command[8] = height >> 8;
+	command[9] = height & 0x00FF;
+	command[10] = depth;
+}
+
+/*******************************************************************************
+* Function: prvCopyString
+*
+* Description: Copies at most max characters of a string into a command
+*  buffer, followed by its null terminator.
+*
+* return: The number of characters copied, not counting the terminator
+*******************************************************************************/
+static uint8_t prvCopyString(uint8_t *buffer, const char *s, uint8_t max) {
+	uint8_t length = 0;
+	
+	while (length < max && s[length] != '\0') {
+		buffer[length] = s[length];
+		length++;
+	}
+	buffer[length] = '\0';
+	
+	return length;
+}
+
+/*******************************************************************************
+* Function: prvReplyAwait
+*
+* Description: Blocks the calling task until the receive interrupt has filled
+*  in the given slot, or for at most REPLY_TIMEOUT_MS. The caller frees the
+*  slot once it has read the result. The task waits on its own notification,
+*  which USART_WriteBlock also uses, so a wake-up only means the slot is worth
+*  checking again. On a timeout the slot is freed here, and the rest of a reply
+*  already arriving for it is dropped. A reply which comes later carries a
+*  sequence number no waiting slot has, so it is dropped as well.
+*
+* return: The filled slot; NULL if no reply came in time
+*******************************************************************************/
+static xReplySlot *prvReplyAwait(xPendingReply pending) {
+	xReplySlot *slot = &replies[pending];
+	portTickType start, waited;
+	
+	/* The handle is read by the receive interrupt, so it is stored whole. */
+	portENTER_CRITICAL();
+	slot->waiter = xTaskGetCurrentTaskHandle();
+	portEXIT_CRITICAL();
+	
+	start = xTaskGetTickCount();
+	while (slot->state != PENDING_DONE) {
+		waited = xTaskGetTickCount() - start;
+		if (waited >= REPLY_TIMEOUT_MS / portTICK_RATE_MS) {
+			break;
+		}
+		ulTaskNotifyTake(pdTRUE, REPLY_TIMEOUT_MS / portTICK_RATE_MS - waited);
+	}
+	
+	portENTER_CRITICAL();
+	if (slot->state != PENDING_DONE) {
+		if (rxSlot == slot) {
+			rxSlot = NULL;
+		}
+		slot->state = PENDING_FREE;
+		slot = NULL;
+	}
+	portEXIT_CRITICAL();
+	if (slot == NULL) {
+		return NULL;
+	}
+	
+	/* The interrupt never touches a finished slot, so no lock is needed. */
+	slot->waiter = NULL;
+	
+	return slot;
+}
+
+/*******************************************************************************
+* Function: prvReplyReceive
+*
+* Description: Receive interrupt handler for the graphics link. Parses tagged
+*  replies and wakes the task waiting on the matching slot. Replies without a
+*  waiting slot are read and dropped.
+*
+* param data: The received byte
+* return: pdTRUE if a task of higher priority than the interrupted one woke
+*******************************************************************************/
+static portBASE_TYPE prvReplyReceive(uint8_t data) {
+	portBASE_TYPE xHigherPriorityTaskWoken = pdFALSE;
+	uint8_t i;
+	
+	switch (rxState) {
+		case RX_SEQ:
+			rxSlot = NULL;
+			for (i = 0; i < MAX_PENDING; i++) {
+				if (replies[i].state == PENDING_WAITING && replies[i].seq == data) {
+					rxSlot = &replies[i];
+					break;
+				}
+			}
+			rxState = RX_LENGTH;
+			return pdFALSE;
 		
-	return hitCount;
-}	
\ No newline at end of file
+		case RX_LENGTH:
+			rxRemaining = data;
+			rxState = RX_PAYLOAD;
+			break;
+		
+		default:
+			if (rxSlot != NULL) {
+				if (rxSlot->count < rxSlot->resultsSize) {
+					rxSlot->results[rxSlot->count] = data;
+				}
+				rxSlot->count++;
+			}
+			rxRemaining--;
+			break;
+	}
+	
+	if (rxRemaining == 0) {
+		if (rxSlot != NULL) {
+			rxSlot->state = PENDING_DONE;
+			if (rxSlot->waiter != NULL) {
+				vTaskNotifyGiveFromISR(rxSlot->waiter, &xHigherPriorityTaskWoken);
+			}
+		}
+		rxState = RX_SEQ;
+	}
+	
+	return xHigherPriorityTaskWoken;
+}
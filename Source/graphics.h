@@ -4,28 +4,79 @@
 #include "FreeRTOS.h"
 
 #define ERROR_HANDLE 0xFF
+#define ERROR_PENDING 0xFF
 #define ALL_GROUP 0x00
 
 typedef uint8_t xSpriteHandle;
 typedef uint8_t xGroupHandle;
+typedef uint8_t xPendingReply;
+typedef uint8_t xImageHandle;
+
+/* Everything needed to create one sprite from a registered image; see
+ * uSpriteCreateBatch. */
+typedef struct {
+	xImageHandle image;
+	uint16_t x;
+	uint16_t y;
+	uint16_t angle;
+	uint16_t width;
+	uint16_t height;
+	uint8_t depth;
+} xSpriteSpec;
+
+/* Most sprites one uSpriteCreateBatch call can create. */
+#define SPRITE_BATCH_MAX 21
+
+/* Longest image file name xSpriteCreate and xImageRegister accept, and longest
+ * string vPrint sends; longer strings are cut short. Each is copied into a
+ * stack buffer with its command and sent in one block. */
+#define IMAGE_NAME_MAX 24
+#define PRINT_MAX_LENGTH 63
 
 void vPrint(const char *s);
+void vRunTimeStatsReport(void);
+void vTraceReport(void);
 void vWindowCreate(uint16_t width, uint16_t height);
 
 xSpriteHandle xSpriteCreate(const char *filename, uint16_t xPos, uint16_t yPos,
  uint16_t rAngle, uint16_t width, uint16_t height, uint8_t order);
+xPendingReply xSpriteCreateAsync(const char *filename, uint16_t xPos,
+ uint16_t yPos, uint16_t rAngle, uint16_t width, uint16_t height,
+ uint8_t order);
+xSpriteHandle xSpriteAwait(xPendingReply pending);
+xImageHandle xImageRegister(const char *filename);
+xSpriteHandle xSpriteCreateById(xImageHandle image, uint16_t xPos,
+ uint16_t yPos, uint16_t rAngle, uint16_t width, uint16_t height,
+ uint8_t order);
+xPendingReply xSpriteCreateByIdAsync(xImageHandle image, uint16_t xPos,
+ uint16_t yPos, uint16_t rAngle, uint16_t width, uint16_t height,
+ uint8_t order);
 void vSpriteSetPosition(xSpriteHandle sprite, uint16_t x, uint16_t y);
 void vSpriteSetRotation(xSpriteHandle sprite, uint16_t angle);
 void vSpriteSetSize(xSpriteHandle sprite, uint16_t width, uint16_t height);
 void vSpriteSetDepth(xSpriteHandle sprite, uint8_t depth);
 void vSpriteDelete(xSpriteHandle sprite);
+uint8_t uSpriteCreateBatch(xGroupHandle group, const xSpriteSpec specs[],
+ uint8_t count, xSpriteHandle handles[]);
+uint8_t uSpriteDeleteList(const xSpriteHandle handles[], uint8_t count);
 
 xGroupHandle xGroupCreate(void);
+xPendingReply xGroupCreateAsync(void);
+xGroupHandle xGroupAwait(xPendingReply pending);
 void vGroupAddSprite(xGroupHandle group, xSpriteHandle sprite);
 void vGroupRemoveSprite(xGroupHandle group, xSpriteHandle sprite);
 void vGroupDelete(xGroupHandle group);
+uint8_t uGroupClear(xGroupHandle group);
 
 uint8_t uCollide(xSpriteHandle sprite, xGroupHandle group,
  xSpriteHandle hits[], uint8_t hitsSize);
+xPendingReply xCollideAsync(xSpriteHandle sprite, xGroupHandle group,
+ xSpriteHandle hits[], uint8_t hitsSize);
+uint8_t uCollideAwait(xPendingReply pending);
+
+void vFrameBegin(void);
+void vSpriteBatchTransform(xSpriteHandle sprite, uint16_t x, uint16_t y,
+ uint16_t angle);
+void vFrameEnd(void);
 
 #endif /* GRAPHICS_H_ */
\ No newline at end of file
@@ -0,0 +1,10 @@
+#ifndef PGMSPACE_H_
+#define PGMSPACE_H_
+
+/* Lets AVR sources which keep tables in flash build on the host, where flash
+ * is ordinary memory. */
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+
+#endif /* PGMSPACE_H_ */
@@ -0,0 +1,213 @@
+/*******************************************************************************
+* File: fixed_check.c
+*
+* Description: Checks the fixed-point math in fixed.c and fixed.h against
+*  floating point on the host. For every input, the lookups and conversions
+*  must give the rounded float result exactly, or within half a step of the
+*  sine table. A bullet is then flown for its whole life at every whole-degree
+*  heading in both, and the largest drift is printed.
+*
+*  From the Source directory:
+*   gcc -std=c99 -Wall -I host host/fixed_check.c -lm -o fixed_check
+*   ./fixed_check
+*
+*  Exits with 0 if every check passed.
+*
+*******************************************************************************/
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../fixed.c"
+
+/* As in asteroids.c */
+#define FRAME_DELAY_MS 10
+#define BULLET_LIFE_MS 1000
+#define BULLET_LIFE_FRAMES (BULLET_LIFE_MS / FRAME_DELAY_MS)
+#define BULLET_SPEED 6.0
+#define BULLET_VEL VEL_CONST(BULLET_SPEED)
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+static int failures = 0;
+
+static void prvFail(const char *what, long input, double expected, long got);
+static void prvCheckSine(void);
+static void prvCheckMulSin(void);
+static void prvCheckConversions(void);
+static void prvFlyBullets(void);
+
+int main(void) {
+	prvCheckSine();
+	prvCheckMulSin();
+	prvCheckConversions();
+	prvFlyBullets();
+
+	if (failures != 0) {
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
+
+/*******************************************************************************
+* Function: prvFail
+*
+* Description: Reports a value which did not match, and counts it. Only the
+*  first few are printed.
+*******************************************************************************/
+static void prvFail(const char *what, long input, double expected, long got) {
+	if (failures++ < 10) {
+		printf("%s(%ld): expected %.3f, got %ld\n", what, input, expected, got);
+	}
+}
+
+/*******************************************************************************
+* Function: prvCheckSine
+*
+* Description: fxSin and fxCos of every whole degree over several turns, in
+*  both directions, against the float result in Q1.14. The table is rounded to
+*  nearest, so each value must be within half a step; the same angle a turn
+*  away must give exactly the same value.
+*******************************************************************************/
+static void prvCheckSine(void) {
+	int16_t angle;
+	double radians, error, worst = 0.0;
+
+	for (angle = -720; angle < 1080; angle++) {
+		radians = angle * M_PI / 180.0;
+
+		error = fabs(fxSin(angle) - sin(radians) * (1 << SIN_FRAC_BITS));
+		if (error > 0.5) {
+			prvFail("fxSin", angle, sin(radians) * (1 << SIN_FRAC_BITS), fxSin(angle));
+		}
+		if (error > worst) {
+			worst = error;
+		}
+
+		error = fabs(fxCos(angle) - cos(radians) * (1 << SIN_FRAC_BITS));
+		if (error > 0.5) {
+			prvFail("fxCos", angle, cos(radians) * (1 << SIN_FRAC_BITS), fxCos(angle));
+		}
+		if (error > worst) {
+			worst = error;
+		}
+
+		if (fxSin(angle) != fxSin(angle + 360)) {
+			prvFail("fxSin a turn on", angle, fxSin(angle), fxSin(angle + 360));
+		}
+	}
+
+	printf("fxSin/fxCos: worst error %.3f of a Q1.14 step\n", worst);
+}
+
+/*******************************************************************************
+* Function: prvCheckMulSin
+*
+* Description: fxMulSin of every int16_t value by every sine in the table and
+*  its negation, against the product rounded half up in double, which holds
+*  every such product exactly. -32768 * -1.0 is left out, as it does not fit.
+*******************************************************************************/
+static void prvCheckMulSin(void) {
+	int32_t value;
+	int16_t angle, sine;
+	double expected;
+
+	for (angle = 0; angle <= 90; angle++) {
+		sine = fxSin(angle);
+		for (value = INT16_MIN; value <= INT16_MAX; value++) {
+			expected = floor((double)value * sine / (1 << SIN_FRAC_BITS) + 0.5);
+			if (fxMulSin((int16_t)value, sine) != expected) {
+				prvFail("fxMulSin", value, expected, fxMulSin((int16_t)value, sine));
+			}
+			expected = floor((double)value * -sine / (1 << SIN_FRAC_BITS) + 0.5);
+			if (expected <= INT16_MAX && fxMulSin((int16_t)value, -sine) != expected) {
+				prvFail("fxMulSin -", value, expected, fxMulSin((int16_t)value, -sine));
+			}
+		}
+	}
+
+	printf("fxMulSin: checked against double for every int16_t value\n");
+}
+
+/*******************************************************************************
+* Function: prvCheckConversions
+*
+* Description: VEL_TO_POS of every int16_t velocity, and the pixel to position
+*  conversions over the window and beyond, against float.
+*******************************************************************************/
+static void prvCheckConversions(void) {
+	int32_t value;
+	double expected;
+
+	for (value = INT16_MIN; value <= INT16_MAX; value++) {
+		expected = floor((double)value / (1 << (VEL_FRAC_BITS - POS_FRAC_BITS)) + 0.5);
+		if (VEL_TO_POS((int16_t)value) != expected) {
+			prvFail("VEL_TO_POS", value, expected, VEL_TO_POS((int16_t)value));
+		}
+	}
+
+	for (value = 0; value < 2048; value++) {
+		if (POS_TO_PIX(PIX_TO_POS(value)) != value) {
+			prvFail("POS_TO_PIX(PIX_TO_POS)", value, value, POS_TO_PIX(PIX_TO_POS(value)));
+		}
+	}
+
+	if (fabs(BULLET_VEL - BULLET_SPEED * (1 << VEL_FRAC_BITS)) > 0.5) {
+		prvFail("VEL_CONST", 6, BULLET_SPEED * (1 << VEL_FRAC_BITS), BULLET_VEL);
+	}
+
+	printf("VEL_TO_POS, PIX_TO_POS, POS_TO_PIX, VEL_CONST: exact\n");
+}
+
+/*******************************************************************************
+* Function: prvFlyBullets
+*
+* Description: Moves a bullet for BULLET_LIFE_FRAMES frames at every heading,
+*  as updateTask does, in fixed point and in double, without wrapping. Each
+*  frame VEL_TO_POS rounds the velocity to a sixteenth of a pixel, and
+*  fxMulSin rounds it to a 256th, so the drift can be at most
+*  BULLET_LIFE_FRAMES * (1/32 + 1/512) pixels on each axis.
+*******************************************************************************/
+static void prvFlyBullets(void) {
+	int16_t angle, frame, posX, posY, velX, velY;
+	double x, y, dx, dy, drift, worst = 0.0;
+	double bound = BULLET_LIFE_FRAMES * (1.0 / 32 + 1.0 / 512);
+	int16_t worstAngle = 0;
+
+	for (angle = 0; angle < 360; angle++) {
+		posX = PIX_TO_POS(400);
+		posY = PIX_TO_POS(300);
+		velX = -fxMulSin(BULLET_VEL, fxSin(angle));
+		velY = -fxMulSin(BULLET_VEL, fxCos(angle));
+		x = 400.0;
+		y = 300.0;
+		dx = -BULLET_SPEED * sin(angle * M_PI / 180.0);
+		dy = -BULLET_SPEED * cos(angle * M_PI / 180.0);
+
+		for (frame = 0; frame < BULLET_LIFE_FRAMES; frame++) {
+			posX += VEL_TO_POS(velX);
+			posY += VEL_TO_POS(velY);
+			x += dx;
+			y += dy;
+		}
+
+		drift = fabs((double)posX / (1 << POS_FRAC_BITS) - x);
+		if (fabs((double)posY / (1 << POS_FRAC_BITS) - y) > drift) {
+			drift = fabs((double)posY / (1 << POS_FRAC_BITS) - y);
+		}
+		if (drift > bound) {
+			prvFail("bullet drift at heading", angle, bound, (long)drift);
+		}
+		if (drift > worst) {
+			worst = drift;
+			worstAngle = angle;
+		}
+	}
+
+	printf("bullet after %d frames: worst drift %.3f px at %d degrees (bound %.3f px)\n",
+	 BULLET_LIFE_FRAMES, worst, worstAngle, bound);
+}
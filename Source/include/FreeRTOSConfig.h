@@ -78,7 +78,11 @@
                                                                     // Use 1000Hz to get mSec timing.
 
 //	#define configCPU_CLOCK_HZ		( ( uint32_t ) F_CPU)			// This define set by Eclipse environment
-	#define configCPU_CLOCK_HZ		( ( uint32_t ) 16000000 )		// Arduino Mega2560 Rev3
+	#define configCPU_CLOCK_HZ		( 16000000UL )					// Arduino Mega2560 Rev3. Not cast, so port.c can test it with #if.
+	#define configUSE_TICKLESS_IDLE	1								// Sleep through idle periods with the tick suppressed. Needs a 16 bit tick timer.
+	#define configGENERATE_RUN_TIME_STATS	1						// Count each task's run time in microseconds on Timer5.
+	#define configUSE_TRACE_RECORDER		1						// Record kernel events for the host, see trace.h. Needs run time stats.
+	#define configRUN_KERNEL_BENCHMARK		0						// Run benchmark.c's cycle counts on Timer4 instead of the game.
 
 
 //	XRAM device options. Different methods of enabling and driving.    MegaRAM only implemented for two banks of 56kByte currently.
@@ -176,22 +180,24 @@
 #define configUSE_PREEMPTION		    1
 #define configUSE_IDLE_HOOK		        0
 #define configUSE_TICK_HOOK		        0
-#define configMAX_PRIORITIES		    ( ( unsigned portBASE_TYPE ) 4 )
+#define configMAX_PRIORITIES		    ( 6 )
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION 1
 #define configMINIMAL_STACK_SIZE	    ( ( uint16_t ) 85 )
 #define configMAX_TASK_NAME_LEN		    ( 16 )
-#define configUSE_TRACE_FACILITY	    0
-#define configUSE_16_BIT_TICKS		    1
+#define configUSE_TRACE_FACILITY	    1
+#define configUSE_16_BIT_TICKS		    0
 #define configIDLE_SHOULD_YIELD		    1
 #define configUSE_MUTEXES               1
 #define configUSE_RECURSIVE_MUTEXES     0
 #define configUSE_COUNTING_SEMAPHORES   0
 #define configUSE_ALTERNATIVE_API       0
+#define configUSE_TASK_NOTIFICATIONS    1
 #define configCHECK_FOR_STACK_OVERFLOW  1
 #define configQUEUE_REGISTRY_SIZE	    0
 
 /* Timer definitions. */
 #define configUSE_TIMERS				0
-#define configTIMER_TASK_PRIORITY       ( ( unsigned portBASE_TYPE ) 7 )
+#define configTIMER_TASK_PRIORITY       ( ( unsigned portBASE_TYPE ) ( configMAX_PRIORITIES - 1 ) )
 #define configTIMER_QUEUE_LENGTH        ( ( unsigned portBASE_TYPE ) 10 )
 #define configTIMER_TASK_STACK_DEPTH    configMINIMAL_STACK_SIZE
 
@@ -211,7 +217,12 @@ to exclude the API function. */
 #define INCLUDE_vTaskDelayUntil			        1
 #define INCLUDE_vTaskDelay			            1
 #define INCLUDE_xTaskGetSchedulerState          0
-#define INCLUDE_xTaskGetCurrentTaskHandle       0
+#define INCLUDE_xTaskGetCurrentTaskHandle       1
 #define INCLUDE_uxTaskGetStackHighWaterMark     1
 
+/* The recorder's trace macros replace the empty defaults in FreeRTOS.h. */
+#if configUSE_TRACE_RECORDER == 1
+	#include "trace.h"
+#endif
+
 #endif /* FREERTOS_CONFIG_H */
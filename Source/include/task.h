@@ -141,6 +141,32 @@ typedef enum
 	eDeleted		/* The task being queried has been deleted, but its TCB has not yet been freed. */
 } eTaskState;
 
+/* The run time of one task, as filled in by uxTaskGetRunTimeStats(). */
+typedef struct xTASK_RUN_TIME
+{
+	xTaskHandle xHandle;						/* The handle of the task. */
+	const signed char *pcTaskName;				/* The name of the task.  Only valid while the task exists. */
+	unsigned portBASE_TYPE uxPriority;			/* The priority the task was running at when the stats were taken. */
+	unsigned long ulRunTimeCounter;				/* The time the task has spent in the Running state, in run time counter units. */
+} xTaskRunTimeType;
+
+/* Possible return values for eTaskConfirmSleepModeStatus(). */
+typedef enum
+{
+	eAbortSleep = 0,		/* A task has been made ready or a context switch pended since portSUPPRESS_TICKS_AND_SLEEP() was called - abort entering a sleep mode. */
+	eStandardSleep			/* Enter a sleep mode that will not last any longer than the expected idle time. */
+} eSleepModeStatus;
+
+/* Actions that can be performed when xTaskNotify() is called. */
+typedef enum
+{
+	eNoAction = 0,				/* Notify the task without updating its notify value. */
+	eSetBits,					/* Set bits in the task's notification value. */
+	eIncrement,					/* Increment the task's notification value. */
+	eSetValueWithOverwrite,		/* Set the task's notification value to a specific value even if the previous value has not yet been read by the task. */
+	eSetValueWithoutOverwrite	/* Set the task's notification value if the previous value has been read by the task. */
+} eNotifyAction;
+
 /*
  * Defines the priority used by the idle task.  This must not be modified.
  *
@@ -1113,6 +1139,33 @@ void vTaskList( signed char *pcWriteBuffer ) PRIVILEGED_FUNCTION;
  */
 void vTaskGetRunTimeStats( signed char *pcWriteBuffer ) PRIVILEGED_FUNCTION;
 
+/**
+ * task.h
+ * <PRE>unsigned portBASE_TYPE uxTaskGetRunTimeStats( xTaskRunTimeType *pxTaskRunTimes, unsigned portBASE_TYPE uxArraySize, unsigned long *pulTotalRunTime );</PRE>
+ *
+ * configGENERATE_RUN_TIME_STATS must be defined as 1 for this function to be
+ * available.
+ *
+ * The binary form of vTaskGetRunTimeStats().  Fills pxTaskRunTimes with the
+ * accumulated run time of each task, without formatting anything, so the
+ * figures can be sent elsewhere to be turned into a table.  The scheduler is
+ * suspended while the task lists are walked.
+ *
+ * @param pxTaskRunTimes The array to fill, one entry per task.
+ *
+ * @param uxArraySize The number of entries in pxTaskRunTimes.  Tasks beyond
+ * this number are left out.
+ *
+ * @param pulTotalRunTime Set to the run time counter value, that is the total
+ * time since the scheduler started, if not NULL.
+ *
+ * @return The number of entries filled in.
+ *
+ * \page uxTaskGetRunTimeStats uxTaskGetRunTimeStats
+ * \ingroup TaskUtils
+ */
+unsigned portBASE_TYPE uxTaskGetRunTimeStats( xTaskRunTimeType *pxTaskRunTimes, unsigned portBASE_TYPE uxArraySize, unsigned long *pulTotalRunTime ) PRIVILEGED_FUNCTION;
+
 /**
  * task.h
  * <PRE>unsigned portBASE_TYPE uxTaskGetStackHighWaterMark( xTaskHandle xTask );</PRE>
@@ -1182,6 +1235,117 @@ portBASE_TYPE xTaskCallApplicationTaskHook( xTaskHandle xTask, void *pvParameter
  */
 xTaskHandle xTaskGetIdleTaskHandle( void );
 
+/**
+ * task. h
+ * <pre>portBASE_TYPE xTaskNotify( xTaskHandle xTaskToNotify, unsigned long ulValue, eNotifyAction eAction );</pre>
+ *
+ * configUSE_TASK_NOTIFICATIONS must be defined as 1 for this function to be
+ * available.
+ *
+ * Each task has a 32 bit notification value and a notification state, held in
+ * its TCB.  Sending a notification to a task unblocks it if it is waiting in
+ * xTaskNotifyWait() or ulTaskNotifyTake(), and otherwise leaves the
+ * notification pending so the next wait returns immediately.  A notification
+ * can stand in for a binary or counting semaphore, an event group of bits, or
+ * a single value mailbox, without allocating a queue.
+ *
+ * Unlike a queue or semaphore only one task, the task being notified, can
+ * wait for a notification, and a task can wait on only one notification at a
+ * time, so a task must not be notified for two different purposes.
+ *
+ * @param xTaskToNotify The handle of the task being notified.
+ *
+ * @param ulValue Used to update the notification value, as set by eAction.
+ *
+ * @param eAction eNoAction leaves the value unchanged, eSetBits ORs ulValue
+ * into it, eIncrement adds one to it (ulValue is unused), and
+ * eSetValueWithOverwrite sets it to ulValue.  eSetValueWithoutOverwrite sets
+ * it to ulValue only if no notification is already pending.
+ *
+ * @return pdFAIL if eAction is eSetValueWithoutOverwrite and a notification
+ * was already pending, otherwise pdPASS.
+ *
+ * \defgroup xTaskNotify xTaskNotify
+ * \ingroup TaskNotifications
+ */
+portBASE_TYPE xTaskNotify( xTaskHandle xTaskToNotify, unsigned long ulValue, eNotifyAction eAction ) PRIVILEGED_FUNCTION;
+
+/**
+ * task. h
+ * <pre>portBASE_TYPE xTaskNotifyFromISR( xTaskHandle xTaskToNotify, unsigned long ulValue, eNotifyAction eAction, signed portBASE_TYPE *pxHigherPriorityTaskWoken );</pre>
+ *
+ * A version of xTaskNotify() that can be used from an interrupt service
+ * routine.
+ *
+ * @param pxHigherPriorityTaskWoken Set to pdTRUE if the notification unblocked
+ * a task with a priority higher than the running task, in which case a
+ * context switch should be requested before the interrupt exits.
+ *
+ * \defgroup xTaskNotifyFromISR xTaskNotifyFromISR
+ * \ingroup TaskNotifications
+ */
+portBASE_TYPE xTaskNotifyFromISR( xTaskHandle xTaskToNotify, unsigned long ulValue, eNotifyAction eAction, signed portBASE_TYPE *pxHigherPriorityTaskWoken ) PRIVILEGED_FUNCTION;
+
+/**
+ * task. h
+ * <pre>portBASE_TYPE xTaskNotifyWait( unsigned long ulBitsToClearOnEntry, unsigned long ulBitsToClearOnExit, unsigned long *pulNotificationValue, portTickType xTicksToWait );</pre>
+ *
+ * Waits, optionally in the Blocked state, for the calling task to be sent a
+ * notification.
+ *
+ * @param ulBitsToClearOnEntry Bits cleared in the notification value on entry,
+ * if no notification is already pending.
+ *
+ * @param ulBitsToClearOnExit Bits cleared in the notification value after it
+ * has been copied out, if a notification was received.
+ *
+ * @param pulNotificationValue Receives the notification value before
+ * ulBitsToClearOnExit is applied.  May be NULL.
+ *
+ * @param xTicksToWait The maximum time to wait in the Blocked state.
+ *
+ * @return pdTRUE if a notification was received, or pdFALSE if the call timed
+ * out.
+ *
+ * \defgroup xTaskNotifyWait xTaskNotifyWait
+ * \ingroup TaskNotifications
+ */
+portBASE_TYPE xTaskNotifyWait( unsigned long ulBitsToClearOnEntry, unsigned long ulBitsToClearOnExit, unsigned long *pulNotificationValue, portTickType xTicksToWait ) PRIVILEGED_FUNCTION;
+
+/**
+ * task. h
+ * <pre>portBASE_TYPE xTaskNotifyGive( xTaskHandle xTaskToNotify );</pre>
+ * <pre>void vTaskNotifyGiveFromISR( xTaskHandle xTaskToNotify, signed portBASE_TYPE *pxHigherPriorityTaskWoken );</pre>
+ *
+ * Increment the notification value of xTaskToNotify, for use with
+ * ulTaskNotifyTake() as a lighter weight binary or counting semaphore.
+ *
+ * \defgroup xTaskNotifyGive xTaskNotifyGive
+ * \ingroup TaskNotifications
+ */
+#define xTaskNotifyGive( xTaskToNotify ) xTaskNotify( ( xTaskToNotify ), 0, eIncrement )
+#define vTaskNotifyGiveFromISR( xTaskToNotify, pxHigherPriorityTaskWoken ) ( void ) xTaskNotifyFromISR( ( xTaskToNotify ), 0, eIncrement, ( pxHigherPriorityTaskWoken ) )
+
+/**
+ * task. h
+ * <pre>unsigned long ulTaskNotifyTake( portBASE_TYPE xClearCountOnExit, portTickType xTicksToWait );</pre>
+ *
+ * Waits, optionally in the Blocked state, for the calling task's notification
+ * value to be non-zero, in the way xSemaphoreTake() waits on a semaphore.
+ *
+ * @param xClearCountOnExit pdTRUE to clear the value to zero on exit, as for a
+ * binary semaphore, or pdFALSE to decrement it, as for a counting semaphore.
+ *
+ * @param xTicksToWait The maximum time to wait in the Blocked state.
+ *
+ * @return The notification value before it was cleared or decremented, which
+ * is zero if the call timed out.
+ *
+ * \defgroup ulTaskNotifyTake ulTaskNotifyTake
+ * \ingroup TaskNotifications
+ */
+unsigned long ulTaskNotifyTake( portBASE_TYPE xClearCountOnExit, portTickType xTicksToWait ) PRIVILEGED_FUNCTION;
+
 /*-----------------------------------------------------------
  * SCHEDULER INTERNALS AVAILABLE FOR PORTING PURPOSES
  *----------------------------------------------------------*/
@@ -1329,6 +1493,20 @@ void vTaskSetTaskNumber( xTaskHandle xTask, unsigned portBASE_TYPE uxHandle );
  */
 void vTaskStepTick( portTickType xTicksToJump );
 
+/*
+ * Provided for use within portSUPPRESS_TICKS_AND_SLEEP() to allow the port
+ * specific sleep function to determine if it is ok to proceed with the sleep.
+ *
+ * This function is necessary because portSUPPRESS_TICKS_AND_SLEEP() is only
+ * called with the scheduler suspended, not from within a critical section.  It
+ * is therefore possible for an interrupt to request a context switch between
+ * portSUPPRESS_TICKS_AND_SLEEP() and the low power mode actually being
+ * entered.  eTaskConfirmSleepModeStatus() should be called from a short
+ * critical section between the timer being stopped and the sleep mode being
+ * entered to ensure it is ok to proceed into the sleep mode.
+ */
+eSleepModeStatus eTaskConfirmSleepModeStatus( void );
+
 #ifdef __cplusplus
 }
 #endif
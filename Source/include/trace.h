@@ -0,0 +1,102 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+
+/* Kernel event recorder. FreeRTOSConfig.h includes this header when
+ * configUSE_TRACE_RECORDER is 1, so the trace macros below replace the empty
+ * defaults in FreeRTOS.h. Events go into a ring that overwrites its oldest
+ * records, so the events leading up to a trigger are always there to dump.
+ *
+ * A record is the event, the task or queue it concerns, and bits 17..2 of the
+ * microsecond clock. A TRACE_CLOCK record carrying bits 31..18 comes first
+ * whenever those change. Records are stored, and sent, little-endian. */
+typedef struct xTRACE_RECORD {
+	uint8_t event;
+	uint8_t object;
+	uint16_t time;
+} xTraceRecord;
+
+/* The ring is taken from the heap, which is in XRAM when there is some. A game
+ * frame makes roughly 15 to 25 records (counted from the events one frame
+ * raises, not measured), so 128 records cover only the last 5 to 8 frames,
+ * 50 to 80ms, before the trigger. 2048 records cover over a second. */
+#ifndef configTRACE_RING_RECORDS
+	#if defined( portEXT_RAM ) && !defined( portEXT_RAMFS )
+		#define configTRACE_RING_RECORDS	2048
+	#else
+		#define configTRACE_RING_RECORDS	128
+	#endif
+#endif
+
+/* Tasks and queues which can be given names for the host. */
+#define traceMAX_TASKS		8
+#define traceMAX_QUEUES		8
+
+/* Events. The object is a task number for the task events, a queue number
+ * (from 1, 0 if unknown) for the queue events and the caller's id for a mark. */
+#define TRACE_CLOCK						0
+#define TRACE_SWITCHED_IN				1
+#define TRACE_READY						2
+#define TRACE_DELAY						3
+#define TRACE_DELAY_UNTIL				4
+#define TRACE_QUEUE_SEND				5
+#define TRACE_QUEUE_SEND_FAILED			6
+#define TRACE_QUEUE_RECEIVE				7
+#define TRACE_QUEUE_RECEIVE_FAILED		8
+#define TRACE_BLOCK_ON_SEND				9
+#define TRACE_BLOCK_ON_RECEIVE			10
+#define TRACE_QUEUE_SEND_FROM_ISR		11
+#define TRACE_QUEUE_RECEIVE_FROM_ISR	12
+#define TRACE_NOTIFY					13
+#define TRACE_NOTIFY_FROM_ISR			14
+#define TRACE_NOTIFY_TAKEN				15
+#define TRACE_TASK_CREATE				16
+#define TRACE_MARK						17
+#define TRACE_TRIGGER					18
+
+void vTraceInit(void);
+void vTraceStart(void);
+void vTraceTrigger(void);
+uint8_t uTraceTriggered(void);
+void vTraceMark(uint8_t id);
+uint16_t uTraceRead(xTraceRecord *records, uint16_t max);
+uint16_t uTraceLost(void);
+void vTraceNameQueue(void *queue, const char *name);
+const char *pcTraceTaskName(uint8_t number);
+const char *pcTraceQueueName(uint8_t number);
+
+/* Called by the kernel through the macros below. */
+void vTraceRecord(uint8_t event, uint8_t object);
+void vTraceSwitchedIn(uint8_t number);
+void vTraceTaskCreated(uint8_t number, const signed char *name);
+uint8_t uTraceQueueCreated(void);
+
+/* Task numbers are the kernel's uxTCBNumber, so configUSE_TRACE_FACILITY must
+ * be 1. traceTASK_INCREMENT_TICK is not hooked. The tick interrupt still runs
+ * the scheduler every tick, so traceTASK_SWITCHED_IN is called at 1kHz while
+ * any task is running; only the calls which change task are recorded.
+ * prvAddTaskToReadyQueue gives traceMOVED_TASK_TO_READY_STATE no semicolon of
+ * its own, so that macro brings one. */
+#define traceTASK_SWITCHED_IN()					vTraceSwitchedIn( ( uint8_t ) pxCurrentTCB->uxTCBNumber )
+#define traceMOVED_TASK_TO_READY_STATE( pxTCB )	vTraceRecord( TRACE_READY, ( uint8_t ) ( pxTCB )->uxTCBNumber );
+#define traceTASK_DELAY()						vTraceRecord( TRACE_DELAY, ( uint8_t ) pxCurrentTCB->uxTCBNumber )
+#define traceTASK_DELAY_UNTIL()					vTraceRecord( TRACE_DELAY_UNTIL, ( uint8_t ) pxCurrentTCB->uxTCBNumber )
+#define traceTASK_CREATE( pxNewTCB )			vTraceTaskCreated( ( uint8_t ) ( pxNewTCB )->uxTCBNumber, ( pxNewTCB )->pcTaskName )
+#define traceTASK_NOTIFY( pxTCB )				vTraceRecord( TRACE_NOTIFY, ( uint8_t ) ( pxTCB )->uxTCBNumber )
+#define traceTASK_NOTIFY_FROM_ISR( pxTCB )		vTraceRecord( TRACE_NOTIFY_FROM_ISR, ( uint8_t ) ( pxTCB )->uxTCBNumber )
+#define traceTASK_NOTIFY_TAKE()					vTraceRecord( TRACE_NOTIFY_TAKEN, ( uint8_t ) pxCurrentTCB->uxTCBNumber )
+#define traceTASK_NOTIFY_WAIT()					vTraceRecord( TRACE_NOTIFY_TAKEN, ( uint8_t ) pxCurrentTCB->uxTCBNumber )
+
+#define traceQUEUE_CREATE( pxNewQueue )			( pxNewQueue )->ucQueueNumber = uTraceQueueCreated()
+#define traceCREATE_MUTEX( pxNewQueue )			( pxNewQueue )->ucQueueNumber = uTraceQueueCreated()
+#define traceQUEUE_SEND( pxQueue )				vTraceRecord( TRACE_QUEUE_SEND, ( pxQueue )->ucQueueNumber )
+#define traceQUEUE_SEND_FAILED( pxQueue )		vTraceRecord( TRACE_QUEUE_SEND_FAILED, ( pxQueue )->ucQueueNumber )
+#define traceQUEUE_RECEIVE( pxQueue )			vTraceRecord( TRACE_QUEUE_RECEIVE, ( pxQueue )->ucQueueNumber )
+#define traceQUEUE_RECEIVE_FAILED( pxQueue )	vTraceRecord( TRACE_QUEUE_RECEIVE_FAILED, ( pxQueue )->ucQueueNumber )
+#define traceBLOCKING_ON_QUEUE_SEND( pxQueue )	vTraceRecord( TRACE_BLOCK_ON_SEND, ( pxQueue )->ucQueueNumber )
+#define traceBLOCKING_ON_QUEUE_RECEIVE( pxQueue )	vTraceRecord( TRACE_BLOCK_ON_RECEIVE, ( pxQueue )->ucQueueNumber )
+#define traceQUEUE_SEND_FROM_ISR( pxQueue )		vTraceRecord( TRACE_QUEUE_SEND_FROM_ISR, ( pxQueue )->ucQueueNumber )
+#define traceQUEUE_RECEIVE_FROM_ISR( pxQueue )	vTraceRecord( TRACE_QUEUE_RECEIVE_FROM_ISR, ( pxQueue )->ucQueueNumber )
+
+#endif /* TRACE_H_ */
@@ -337,6 +337,7 @@ void	 W5100_init(void); // reset W5100 - First call to make
 void	 W5100_sysinit(uint8_t tx_size, uint8_t rx_size); // setting tx/rx buf size
 uint8_t  W5100_getISR(uint8_t s);
 void	 W5100_putISR(uint8_t s, uint8_t val);
+void	 W5100_setNotifyTask(void *task); // task (xTaskHandle) notified with the IR bits from the interrupt routine, NULL for none
 
 uint8_t	 W5100_READ( uint16_t addr);
 uint8_t	 W5100_WRITE(uint16_t addr, uint8_t data);
@@ -73,6 +73,8 @@ static uint16_t RBUFBASEADDRESS[MAX_SOCK_NUM]; /**< Rx buffer base address by ea
 
 static uint8_t SUBN_VAR[4]; // off-chip subnet mask address - solve Errata 2 & 3 v1.6 - March 2012
 
+static xTaskHandle NOTIFY_TASK = NULL; /**< Task notified from the interrupt routine, if any */
+
 uint8_t W5100_getISR(uint8_t s)
 {
 	return I_STATUS[s];
@@ -81,6 +83,12 @@ void W5100_putISR(uint8_t s, uint8_t val)
 {
    I_STATUS[s] = val;
 }
+void W5100_setNotifyTask(void *task)
+{
+   portENTER_CRITICAL();
+   NOTIFY_TASK = (xTaskHandle)task;
+   portEXIT_CRITICAL();
+}
 uint16_t getW5100_RxMAX(uint8_t s)
 {
    return RSIZE[s];
@@ -421,6 +429,8 @@ ISR(INT0_vect)
 {
 #ifdef __DEF_W5100_INT__
 	uint8_t int_val;
+	uint8_t int_seen = 0;
+	portBASE_TYPE woken = pdFALSE;
 
 	W5100_ISR_DISABLE();
 	int_val = W5100_READ(IR);
@@ -440,6 +450,8 @@ ISR(INT0_vect)
    		xSerialPrintf_P(PSTR("UPORT0 : %.2x %.2x\r\n"), W5100_READ(UPORT0), W5100_READ(UPORT0+1));
    	}
 
+   	int_seen |= int_val;
+
    	/* +200801[bj] interrupt clear */
    	W5100_WRITE(IR, 0xf0);
       /*---*/
@@ -482,6 +494,14 @@ ISR(INT0_vect)
 
 	W5100_ISR_ENABLE();
 
+	/* wake the task serving the sockets; the notification value collects the IR bits seen */
+	if (NOTIFY_TASK != NULL)
+	{
+		xTaskNotifyFromISR(NOTIFY_TASK, int_seen, eSetBits, &woken);
+		if (woken != pdFALSE)
+			taskYIELD();
+	}
+
 #endif
 
 }
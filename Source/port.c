@@ -84,6 +84,7 @@ Changes for FiFiSMSer
 
 #include <stdlib.h>
 #include <avr/interrupt.h>
+#include <avr/sleep.h>
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -122,6 +123,13 @@ Changes for FiFiSMSer
 	#define portTCCRa                               TCCR1A
 	#define portTCCRb                              	TCCR1B
 	#define portTIMSK                               TIMSK1
+	#define portCOMPARE_MATCH_B_INTERRUPT_ENABLE	( ( unsigned portCHAR ) (1<<OCIE1B) )
+	#define portOUTPUT_COMPARE_FLAG_A				( ( unsigned portCHAR ) (1<<OCF1A) )
+	#define portOUTPUT_COMPARE_FLAG_B				( ( unsigned portCHAR ) (1<<OCF1B) )
+	#define portOCRA                                OCR1A
+	#define portOCRB                                OCR1B
+	#define portTCNT                                TCNT1
+	#define portTIFR                                TIFR1
 
 #elif defined( portUSE_TIMER3 )
 /* Hardware constants for Timer3. */
@@ -134,6 +142,13 @@ Changes for FiFiSMSer
 	#define portTCCRa                               TCCR3A
 	#define portTCCRb                              	TCCR3B
 	#define portTIMSK                               TIMSK3
+	#define portCOMPARE_MATCH_B_INTERRUPT_ENABLE	( ( unsigned portCHAR ) (1<<OCIE3B) )
+	#define portOUTPUT_COMPARE_FLAG_A				( ( unsigned portCHAR ) (1<<OCF3A) )
+	#define portOUTPUT_COMPARE_FLAG_B				( ( unsigned portCHAR ) (1<<OCF3B) )
+	#define portOCRA                                OCR3A
+	#define portOCRB                                OCR3B
+	#define portTCNT                                TCNT3
+	#define portTIFR                                TIFR3
 
 #endif
 
@@ -146,6 +161,25 @@ extern volatile tskTCB * volatile pxCurrentTCB;
 
 /*-----------------------------------------------------------*/
 
+#if configUSE_PORT_OPTIMISED_TASK_SELECTION == 1
+
+	/* The bit recording each priority in uxTopReadyPriority. */
+	const unsigned portCHAR ucPortPriorityBit[ 8 ] PROGMEM =
+	{
+		0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80
+	};
+
+	/* The number of the highest set bit of each value from 0 to 15.  Entry 0
+	is never looked up, as the idle priority is always ready. */
+	const unsigned portCHAR ucPortHighestBit[ 16 ] PROGMEM =
+	{
+		0, 0, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3
+	};
+
+#endif /* configUSE_PORT_OPTIMISED_TASK_SELECTION */
+
+/*-----------------------------------------------------------*/
+
 /*
  * Macro to save all the general purpose registers, the save the stack pointer
  * into the TCB.
@@ -367,6 +401,24 @@ extern volatile tskTCB * volatile pxCurrentTCB;
 static void prvSetupTimerInterrupt( void );
 /*-----------------------------------------------------------*/
 
+#if configUSE_TICKLESS_IDLE == 1
+
+	#if !defined( portOCRA )
+		#error configUSE_TICKLESS_IDLE needs a 16 bit tick timer.  Use portUSE_TIMER1 or portUSE_TIMER3.
+	#endif
+
+	/* Timer counts in one tick, and the most ticks the 16 bit timer can count
+	through before it must wrap. */
+	#define portTIMER_COUNTS_PER_TICK		( ( unsigned portSHORT ) ( configCPU_CLOCK_HZ / configTICK_RATE_HZ / portCLOCK_PRESCALER ) )
+	#define portMAX_SUPPRESSED_TICKS		( ( portTickType ) ( 0xffffUL / portTIMER_COUNTS_PER_TICK ) )
+
+	/* Sleeps taken, and CPU cycles spent in them, for vPortGetSleepStats(). */
+	static volatile unsigned portLONG ulSleepCount = 0UL;
+	static volatile unsigned portLONG ulSleepCycles = 0UL;
+
+#endif
+/*-----------------------------------------------------------*/
+
 /*
  * See header file for description.
  */
@@ -653,6 +705,192 @@ unsigned portCHAR ucLowByte;
 
 /*-----------------------------------------------------------*/
 
+#if configUSE_TICKLESS_IDLE == 1
+
+	/*
+	 * Called by the idle task, with the scheduler suspended, when no task
+	 * needs the processor for at least xExpectedIdleTime ticks.
+	 *
+	 * The tick timer runs in CTC mode and keeps counting throughout, so no
+	 * time is lost to stopping it.  Its top is raised so the next compare
+	 * match falls xExpectedIdleTime ticks after the last one, and the match
+	 * is taken on compare B, whose handler is empty, so waking does not run
+	 * the tick handler.  On waking the whole ticks that passed are stepped
+	 * over and the timer is put back to one tick per match.
+	 */
+	void vPortSuppressTicksAndSleep( portTickType xExpectedIdleTime )
+	{
+	unsigned portSHORT usStart, usCount, usElapsedTicks;
+
+		if( xExpectedIdleTime > portMAX_SUPPRESSED_TICKS )
+		{
+			xExpectedIdleTime = portMAX_SUPPRESSED_TICKS;
+		}
+
+		portDISABLE_INTERRUPTS();
+
+		/* Abort if a task was readied, or a tick is already waiting, since
+		the idle time was worked out. */
+		if( ( eTaskConfirmSleepModeStatus() == eAbortSleep ) || ( ( portTIFR & portOUTPUT_COMPARE_FLAG_A ) != 0 ) )
+		{
+			portENABLE_INTERRUPTS();
+			return;
+		}
+
+		/* The counter is somewhere in the current tick, which started at 0. */
+		usStart = portTCNT;
+		portOCRA = ( portTIMER_COUNTS_PER_TICK * ( unsigned portSHORT ) xExpectedIdleTime ) - 1;
+		portOCRB = portOCRA;
+
+		if( ( portTIFR & portOUTPUT_COMPARE_FLAG_A ) != 0 )
+		{
+			/* The tick ended while the top was being moved.  Put it back and
+			let the pending tick run. */
+			portOCRA = portTIMER_COUNTS_PER_TICK - 1;
+			portENABLE_INTERRUPTS();
+			return;
+		}
+
+		portTIFR = portOUTPUT_COMPARE_FLAG_B;
+		portTIMSK = ( portTIMSK & ~portCOMPARE_MATCH_A_INTERRUPT_ENABLE ) | portCOMPARE_MATCH_B_INTERRUPT_ENABLE;
+
+		/* sei takes effect after the following instruction, so no interrupt
+		can slip in between enabling them and sleeping. */
+		set_sleep_mode( SLEEP_MODE_IDLE );
+		sleep_enable();
+		portENABLE_INTERRUPTS();
+		sleep_cpu();
+		sleep_disable();
+
+		/* Whatever woke the processor has been handled.  Stop anything else
+		running until the tick is put right. */
+		portDISABLE_INTERRUPTS();
+		portTIMSK = ( portTIMSK & ~portCOMPARE_MATCH_B_INTERRUPT_ENABLE ) | portCOMPARE_MATCH_A_INTERRUPT_ENABLE;
+
+		/* Read the counter before testing the flag.  If the flag is clear
+		afterwards, the counter had not wrapped when it was read.  If it is
+		set, the wrap may have come after the read, so read it again. */
+		usCount = portTCNT;
+		if( ( portTIFR & portOUTPUT_COMPARE_FLAG_A ) != 0 )
+		{
+			/* The whole period passed and the counter has wrapped.  Step all
+			but the last tick, which the pending tick interrupt counts as soon
+			as interrupts are enabled.  A long wake-up interrupt may have let
+			the counter run a tick or more past the wrap.  Step those ticks
+			too and carry the part tick, or it would be past the lowered top
+			and run on to 0xffff. */
+			usCount = portTCNT;
+			usElapsedTicks = usCount / portTIMER_COUNTS_PER_TICK;
+			if( usElapsedTicks > 0 )
+			{
+				portTCNT = usCount - ( usElapsedTicks * portTIMER_COUNTS_PER_TICK );
+			}
+			portOCRA = portTIMER_COUNTS_PER_TICK - 1;
+			usElapsedTicks += ( unsigned portSHORT ) xExpectedIdleTime - 1;
+			ulSleepCycles += ( ( unsigned portLONG ) portTIMER_COUNTS_PER_TICK * xExpectedIdleTime - usStart + usCount ) * portCLOCK_PRESCALER;
+		}
+		else
+		{
+			/* Another interrupt ended the sleep early.  Step the whole ticks
+			that passed and carry the part tick into the counter. */
+			usElapsedTicks = usCount / portTIMER_COUNTS_PER_TICK;
+			portTCNT = usCount - ( usElapsedTicks * portTIMER_COUNTS_PER_TICK );
+			portOCRA = portTIMER_COUNTS_PER_TICK - 1;
+			ulSleepCycles += ( unsigned portLONG ) ( usCount - usStart ) * portCLOCK_PRESCALER;
+		}
+
+		ulSleepCount++;
+		vTaskStepTick( ( portTickType ) usElapsedTicks );
+
+		portENABLE_INTERRUPTS();
+	}
+
+	/*-----------------------------------------------------------*/
+
+	void vPortGetSleepStats( unsigned portLONG *pulSleeps, unsigned portLONG *pulCyclesAsleep )
+	{
+		portENTER_CRITICAL();
+		*pulSleeps = ulSleepCount;
+		*pulCyclesAsleep = ulSleepCycles;
+		portEXIT_CRITICAL();
+	}
+
+	/*-----------------------------------------------------------*/
+
+	/* Ends a tickless sleep.  There is nothing to do but wake. */
+	#if defined( portUSE_TIMER1 )
+		EMPTY_INTERRUPT( TIMER1_COMPB_vect );
+	#elif defined( portUSE_TIMER3 )
+		EMPTY_INTERRUPT( TIMER3_COMPB_vect );
+	#endif
+
+#endif /* configUSE_TICKLESS_IDLE */
+
+/*-----------------------------------------------------------*/
+
+#if configGENERATE_RUN_TIME_STATS == 1
+
+	#if !defined( TCCR5B )
+		#error configGENERATE_RUN_TIME_STATS uses Timer5, which this device does not have.
+	#endif
+
+	/* The shifts below assume 16MHz. */
+	#if configCPU_CLOCK_HZ != 16000000UL
+		#error configGENERATE_RUN_TIME_STATS needs configCPU_CLOCK_HZ to be 16MHz.
+	#endif
+
+	/* Timer5 overflows every 0x10000 counts of 4us, 262144us. */
+	#define portMICROSECONDS_PER_COUNT_SHIFT		2
+	#define portMICROSECONDS_PER_OVERFLOW_SHIFT		18
+
+	static volatile unsigned portLONG ulMicrosecondOverflows = 0UL;
+
+	void vPortMicrosecondClockInit( void )
+	{
+		portENTER_CRITICAL();
+		TCCR5A = 0;
+		TCCR5B = ( 1 << CS51 ) | ( 1 << CS50 );		/* Normal mode, clk/64. */
+		TCNT5 = 0;
+		TIFR5 = ( 1 << TOV5 );
+		TIMSK5 |= ( 1 << TOIE5 );
+		portEXIT_CRITICAL();
+	}
+
+	/*-----------------------------------------------------------*/
+
+	unsigned portLONG ulPortGetMicroseconds( void )
+	{
+	unsigned portLONG ulOverflows;
+	unsigned portSHORT usCount;
+
+		/* Safe to call with interrupts disabled, as it is from
+		vTaskSwitchContext(). */
+		portENTER_CRITICAL();
+		usCount = TCNT5;
+		ulOverflows = ulMicrosecondOverflows;
+
+		/* An overflow not yet counted by its interrupt, if the count read
+		was taken after it. */
+		if( ( ( TIFR5 & ( 1 << TOV5 ) ) != 0 ) && ( usCount < 0x8000U ) )
+		{
+			ulOverflows++;
+		}
+		portEXIT_CRITICAL();
+
+		return ( ulOverflows << portMICROSECONDS_PER_OVERFLOW_SHIFT ) + ( ( unsigned portLONG ) usCount << portMICROSECONDS_PER_COUNT_SHIFT );
+	}
+
+	/*-----------------------------------------------------------*/
+
+	ISR( TIMER5_OVF_vect )
+	{
+		ulMicrosecondOverflows++;
+	}
+
+#endif /* configGENERATE_RUN_TIME_STATS */
+
+/*-----------------------------------------------------------*/
+
 #if configUSE_PREEMPTION == 1
 
 	/*
@@ -132,6 +132,72 @@ extern void vPortYield( void ) __attribute__ ( ( naked ) );
 #define portYIELD()					vPortYield()
 /*-----------------------------------------------------------*/
 
+/* Tickless idle.  The idle task calls portSUPPRESS_TICKS_AND_SLEEP() when no
+task is due to run for two or more ticks; the processor then sleeps in idle
+mode with the tick timer set to wake it when the first task is due.
+vPortGetSleepStats() returns the number of sleeps taken and the CPU cycles
+spent in them, for judging how long a workload leaves the processor idle. */
+#if configUSE_TICKLESS_IDLE == 1
+
+	extern void vPortSuppressTicksAndSleep( portTickType xExpectedIdleTime );
+	extern void vPortGetSleepStats( unsigned portLONG *pulSleeps, unsigned portLONG *pulCyclesAsleep );
+	#define portSUPPRESS_TICKS_AND_SLEEP( xExpectedIdleTime ) vPortSuppressTicksAndSleep( xExpectedIdleTime )
+
+#endif /* configUSE_TICKLESS_IDLE */
+/*-----------------------------------------------------------*/
+
+/* Microsecond clock.  Timer5 runs free at the CPU clock divided by 64, 4us a
+count at 16MHz, and its overflows are counted in software to give a 32 bit
+count of microseconds, which wraps after about 71 minutes.  It is the run time
+stats counter, so each task's ulRunTimeCounter is in microseconds. */
+#if configGENERATE_RUN_TIME_STATS == 1
+
+	extern void vPortMicrosecondClockInit( void );
+	extern unsigned portLONG ulPortGetMicroseconds( void );
+	#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS()	vPortMicrosecondClockInit()
+	#define portGET_RUN_TIME_COUNTER_VALUE()			ulPortGetMicroseconds()
+
+#endif /* configGENERATE_RUN_TIME_STATS */
+/*-----------------------------------------------------------*/
+
+/* Port optimised task selection.  Bit n of uxTopReadyPriority is set while
+the ready list for priority n is not empty.  The AVR has no barrel shifter or
+count-leading-zeros instruction, so both the bit for a priority and the
+highest set bit of each nibble come from small tables in flash, which keeps
+selection to a fixed handful of cycles however many priorities are empty. */
+#if configUSE_PORT_OPTIMISED_TASK_SELECTION == 1
+
+	#include <avr/pgmspace.h>
+
+	/* uxTopReadyPriority is an unsigned portBASE_TYPE, so holds 8 bits. */
+	#if( configMAX_PRIORITIES > 8 )
+		#error configUSE_PORT_OPTIMISED_TASK_SELECTION can only be set to 1 when configMAX_PRIORITIES is less than or equal to 8.
+	#endif
+
+	extern const unsigned portCHAR ucPortPriorityBit[ 8 ] PROGMEM;
+	extern const unsigned portCHAR ucPortHighestBit[ 16 ] PROGMEM;
+
+	#define portRECORD_READY_PRIORITY( uxPriority, uxReadyPriorities ) ( uxReadyPriorities ) |= pgm_read_byte( &ucPortPriorityBit[ ( uxPriority ) ] )
+	#define portRESET_READY_PRIORITY( uxPriority, uxReadyPriorities ) ( uxReadyPriorities ) &= ~pgm_read_byte( &ucPortPriorityBit[ ( uxPriority ) ] )
+
+	/* The idle task is always ready, so uxReadyPriorities is never zero. */
+	#define portGET_HIGHEST_PRIORITY( uxTopPriority, uxReadyPriorities )									\
+	{																										\
+	unsigned portCHAR ucReady = ( uxReadyPriorities );														\
+																											\
+		if( ( ucReady & 0xf0 ) != 0 )																		\
+		{																									\
+			uxTopPriority = 4 + pgm_read_byte( &ucPortHighestBit[ ucReady >> 4 ] );							\
+		}																									\
+		else																								\
+		{																									\
+			uxTopPriority = pgm_read_byte( &ucPortHighestBit[ ucReady ] );									\
+		}																									\
+	}
+
+#endif /* configUSE_PORT_OPTIMISED_TASK_SELECTION */
+/*-----------------------------------------------------------*/
+
 
 //BB had to comment this out...but think it may be a problem that I should address
 
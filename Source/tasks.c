@@ -133,6 +133,11 @@ typedef struct tskTaskControlBlock
 		unsigned long ulRunTimeCounter;			/*< Stores the amount of time the task has spent in the Running state. */
 	#endif
 
+	#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+		volatile unsigned long ulNotifiedValue;	/*< The value sent by xTaskNotify() and friends. */
+		volatile unsigned char ucNotifyState;	/*< One of the taskNOT_WAITING_NOTIFICATION style states below. */
+	#endif
+
 } tskTCB;
 
 
@@ -192,6 +197,7 @@ PRIVILEGED_DATA static volatile portTickType xNextTaskUnblockTime				= ( portTic
 	PRIVILEGED_DATA static char pcStatsString[ 50 ] ;
 	PRIVILEGED_DATA static unsigned long ulTaskSwitchedInTime = 0UL;	/*< Holds the value of a timer/counter the last time a task was switched in. */
 	static void prvGenerateRunTimeStatsForTasksInList( const signed char *pcWriteBuffer, xList *pxList, unsigned long ulTotalRunTime ) PRIVILEGED_FUNCTION;
+	static unsigned portBASE_TYPE prvListRunTimesWithinSingleList( xTaskRunTimeType *pxTaskRunTimes, unsigned portBASE_TYPE uxArraySize, xList *pxList ) PRIVILEGED_FUNCTION;
 
 #endif
 
@@ -211,6 +217,13 @@ PRIVILEGED_DATA static volatile portTickType xNextTaskUnblockTime				= ( portTic
 #define tskDELETED_CHAR		( ( signed char ) 'D' )
 #define tskSUSPENDED_CHAR	( ( signed char ) 'S' )
 
+/*
+ * Values held in ucNotifyState.
+ */
+#define taskNOT_WAITING_NOTIFICATION	( ( unsigned char ) 0 )
+#define taskWAITING_NOTIFICATION		( ( unsigned char ) 1 )
+#define taskNOTIFICATION_RECEIVED		( ( unsigned char ) 2 )
+
 /*-----------------------------------------------------------*/
 
 #if configUSE_PORT_OPTIMISED_TASK_SELECTION == 0
@@ -428,6 +441,18 @@ static void prvCheckTasksWaitingTermination( void ) PRIVILEGED_FUNCTION;
  */
 static void prvAddCurrentTaskToDelayedList( portTickType xTimeToWake ) PRIVILEGED_FUNCTION;
 
+/*
+ * prvBlockForNotification moves the currently executing task, which is waiting
+ * for a notification, from its ready list to the suspended list if it is to
+ * wait indefinitely, or to a delayed list otherwise.  prvNotifyUpdate applies
+ * a notify action to a task's notification value.  Both must be called with
+ * interrupts disabled.
+ */
+#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+	static void prvBlockForNotification( portTickType xTicksToWait ) PRIVILEGED_FUNCTION;
+	static unsigned char prvNotifyUpdate( tskTCB *pxTCB, unsigned long ulValue, eNotifyAction eAction, portBASE_TYPE *pxReturn ) PRIVILEGED_FUNCTION;
+#endif
+
 /*
  * Allocates memory from the heap for a TCB and associated stack.  Checks the
  * allocation was successful.
@@ -1623,6 +1648,55 @@ unsigned portBASE_TYPE uxTaskGetNumberOfTasks( void )
 #endif
 /*----------------------------------------------------------*/
 
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+
+	unsigned portBASE_TYPE uxTaskGetRunTimeStats( xTaskRunTimeType *pxTaskRunTimes, unsigned portBASE_TYPE uxArraySize, unsigned long *pulTotalRunTime )
+	{
+	unsigned portBASE_TYPE uxQueue, uxTask = 0;
+
+		vTaskSuspendAll();
+		{
+			if( pulTotalRunTime != NULL )
+			{
+				#ifdef portALT_GET_RUN_TIME_COUNTER_VALUE
+					portALT_GET_RUN_TIME_COUNTER_VALUE( ( *pulTotalRunTime ) );
+				#else
+					*pulTotalRunTime = portGET_RUN_TIME_COUNTER_VALUE();
+				#endif
+			}
+
+			/* Run through the same lists as vTaskGetRunTimeStats(). */
+			uxQueue = uxTopUsedPriority + ( unsigned portBASE_TYPE ) 1U;
+
+			do
+			{
+				uxQueue--;
+				uxTask += prvListRunTimesWithinSingleList( &( pxTaskRunTimes[ uxTask ] ), uxArraySize - uxTask, ( xList * ) &( pxReadyTasksLists[ uxQueue ] ) );
+			}while( uxQueue > ( unsigned short ) tskIDLE_PRIORITY );
+
+			uxTask += prvListRunTimesWithinSingleList( &( pxTaskRunTimes[ uxTask ] ), uxArraySize - uxTask, ( xList * ) pxDelayedTaskList );
+			uxTask += prvListRunTimesWithinSingleList( &( pxTaskRunTimes[ uxTask ] ), uxArraySize - uxTask, ( xList * ) pxOverflowDelayedTaskList );
+
+			#if ( INCLUDE_vTaskDelete == 1 )
+			{
+				uxTask += prvListRunTimesWithinSingleList( &( pxTaskRunTimes[ uxTask ] ), uxArraySize - uxTask, &xTasksWaitingTermination );
+			}
+			#endif
+
+			#if ( INCLUDE_vTaskSuspend == 1 )
+			{
+				uxTask += prvListRunTimesWithinSingleList( &( pxTaskRunTimes[ uxTask ] ), uxArraySize - uxTask, &xSuspendedTaskList );
+			}
+			#endif
+		}
+		xTaskResumeAll();
+
+		return uxTask;
+	}
+
+#endif
+/*----------------------------------------------------------*/
+
 #if ( INCLUDE_xTaskGetIdleTaskHandle == 1 )
 
 	xTaskHandle xTaskGetIdleTaskHandle( void )
@@ -1648,6 +1722,35 @@ implementations require configUSE_TICKLESS_IDLE to be set to a value other than
 		xTickCount += xTicksToJump;
 	}
 
+#endif
+/*----------------------------------------------------------*/
+
+#if ( configUSE_TICKLESS_IDLE != 0 )
+
+	eSleepModeStatus eTaskConfirmSleepModeStatus( void )
+	{
+	eSleepModeStatus eReturn = eStandardSleep;
+
+		if( listCURRENT_LIST_LENGTH( &xPendingReadyList ) != 0 )
+		{
+			/* A task was made ready while the scheduler was suspended. */
+			eReturn = eAbortSleep;
+		}
+		else if( xMissedYield != pdFALSE )
+		{
+			/* A yield was pended while the scheduler was suspended. */
+			eReturn = eAbortSleep;
+		}
+		else if( uxMissedTicks != ( unsigned portBASE_TYPE ) 0U )
+		{
+			/* A tick was held pending, so the expected idle time is already
+			shorter than the caller was told. */
+			eReturn = eAbortSleep;
+		}
+
+		return eReturn;
+	}
+
 #endif
 
 /*-----------------------------------------------------------
@@ -2269,6 +2372,13 @@ static void prvInitialiseTCBVariables( tskTCB *pxTCB, const signed char * const
 	}
 	#endif
 
+	#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+	{
+		pxTCB->ulNotifiedValue = 0UL;
+		pxTCB->ucNotifyState = taskNOT_WAITING_NOTIFICATION;
+	}
+	#endif
+
 	#if ( portUSING_MPU_WRAPPERS == 1 )
 	{
 		vPortStoreTaskMPUSettings( &( pxTCB->xMPUSettings ), xRegions, pxTCB->pxStack, usStackDepth );
@@ -2458,6 +2568,39 @@ tskTCB *pxNewTCB;
 #endif
 /*-----------------------------------------------------------*/
 
+#if ( configGENERATE_RUN_TIME_STATS == 1 )
+
+	static unsigned portBASE_TYPE prvListRunTimesWithinSingleList( xTaskRunTimeType *pxTaskRunTimes, unsigned portBASE_TYPE uxArraySize, xList *pxList )
+	{
+	volatile tskTCB *pxNextTCB, *pxFirstTCB;
+	unsigned portBASE_TYPE uxTask = 0;
+
+		if( listLIST_IS_EMPTY( pxList ) == pdFALSE )
+		{
+			/* Record each TCB in pxList until the array is full. */
+			listGET_OWNER_OF_NEXT_ENTRY( pxFirstTCB, pxList );
+			do
+			{
+				listGET_OWNER_OF_NEXT_ENTRY( pxNextTCB, pxList );
+
+				if( uxTask < uxArraySize )
+				{
+					pxTaskRunTimes[ uxTask ].xHandle = ( xTaskHandle ) pxNextTCB;
+					pxTaskRunTimes[ uxTask ].pcTaskName = ( const signed char * ) pxNextTCB->pcTaskName;
+					pxTaskRunTimes[ uxTask ].uxPriority = pxNextTCB->uxPriority;
+					pxTaskRunTimes[ uxTask ].ulRunTimeCounter = pxNextTCB->ulRunTimeCounter;
+					uxTask++;
+				}
+
+			} while( pxNextTCB != pxFirstTCB );
+		}
+
+		return uxTask;
+	}
+
+#endif
+/*-----------------------------------------------------------*/
+
 #if ( configGENERATE_RUN_TIME_STATS == 1 )
 
 	static void prvGenerateRunTimeStatsForTasksInList( const signed char *pcWriteBuffer, xList *pxList, unsigned long ulTotalRunTime )
@@ -2754,3 +2897,277 @@ tskTCB *pxNewTCB;
 
 
 
+
+#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+
+	static void prvBlockForNotification( portTickType xTicksToWait )
+	{
+		/* The task is not on an event list, only the generic list item moves. */
+		if( uxListRemove( ( xListItem * ) &( pxCurrentTCB->xGenericListItem ) ) == 0 )
+		{
+			portRESET_READY_PRIORITY( pxCurrentTCB->uxPriority, uxTopReadyPriority );
+		}
+
+		#if ( INCLUDE_vTaskSuspend == 1 )
+		{
+			if( xTicksToWait == portMAX_DELAY )
+			{
+				/* Block indefinitely, without being woken by a timing event. */
+				vListInsertEnd( ( xList * ) &xSuspendedTaskList, ( xListItem * ) &( pxCurrentTCB->xGenericListItem ) );
+			}
+			else
+			{
+				prvAddCurrentTaskToDelayedList( xTickCount + xTicksToWait );
+			}
+		}
+		#else
+		{
+			prvAddCurrentTaskToDelayedList( xTickCount + xTicksToWait );
+		}
+		#endif
+	}
+
+#endif
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+
+	unsigned long ulTaskNotifyTake( portBASE_TYPE xClearCountOnExit, portTickType xTicksToWait )
+	{
+	unsigned long ulReturn;
+
+		taskENTER_CRITICAL();
+		{
+			/* Only block if the notification count is not already non-zero. */
+			if( pxCurrentTCB->ulNotifiedValue == 0UL )
+			{
+				pxCurrentTCB->ucNotifyState = taskWAITING_NOTIFICATION;
+
+				if( xTicksToWait > ( portTickType ) 0 )
+				{
+					prvBlockForNotification( xTicksToWait );
+
+					/* The yield is held pending until the critical section is
+					exited, as it is in the queue implementation. */
+					portYIELD_WITHIN_API();
+				}
+			}
+		}
+		taskEXIT_CRITICAL();
+
+		/* Either notified, timed out, or the count was already non-zero. */
+		taskENTER_CRITICAL();
+		{
+			traceTASK_NOTIFY_TAKE();
+			ulReturn = pxCurrentTCB->ulNotifiedValue;
+
+			if( ulReturn != 0UL )
+			{
+				if( xClearCountOnExit != pdFALSE )
+				{
+					pxCurrentTCB->ulNotifiedValue = 0UL;
+				}
+				else
+				{
+					( pxCurrentTCB->ulNotifiedValue )--;
+				}
+			}
+
+			pxCurrentTCB->ucNotifyState = taskNOT_WAITING_NOTIFICATION;
+		}
+		taskEXIT_CRITICAL();
+
+		return ulReturn;
+	}
+
+#endif
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+
+	portBASE_TYPE xTaskNotifyWait( unsigned long ulBitsToClearOnEntry, unsigned long ulBitsToClearOnExit, unsigned long *pulNotificationValue, portTickType xTicksToWait )
+	{
+	portBASE_TYPE xReturn;
+
+		taskENTER_CRITICAL();
+		{
+			/* Only block if a notification is not already pending. */
+			if( pxCurrentTCB->ucNotifyState != taskNOTIFICATION_RECEIVED )
+			{
+				pxCurrentTCB->ulNotifiedValue &= ~ulBitsToClearOnEntry;
+				pxCurrentTCB->ucNotifyState = taskWAITING_NOTIFICATION;
+
+				if( xTicksToWait > ( portTickType ) 0 )
+				{
+					prvBlockForNotification( xTicksToWait );
+					portYIELD_WITHIN_API();
+				}
+			}
+		}
+		taskEXIT_CRITICAL();
+
+		taskENTER_CRITICAL();
+		{
+			traceTASK_NOTIFY_WAIT();
+
+			if( pulNotificationValue != NULL )
+			{
+				/* Output the value even on a timeout, as it may have changed. */
+				*pulNotificationValue = pxCurrentTCB->ulNotifiedValue;
+			}
+
+			if( pxCurrentTCB->ucNotifyState == taskWAITING_NOTIFICATION )
+			{
+				/* Nothing was received - the wait timed out. */
+				xReturn = pdFALSE;
+			}
+			else
+			{
+				pxCurrentTCB->ulNotifiedValue &= ~ulBitsToClearOnExit;
+				xReturn = pdTRUE;
+			}
+
+			pxCurrentTCB->ucNotifyState = taskNOT_WAITING_NOTIFICATION;
+		}
+		taskEXIT_CRITICAL();
+
+		return xReturn;
+	}
+
+#endif
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+
+	/* Applies eAction to pxTCB's notification value and marks the notification
+	received.  Returns the state the task was in beforehand, or
+	taskNOTIFICATION_RECEIVED with *pxReturn set to pdFAIL if the value could
+	not be written.  Must be called with interrupts disabled. */
+	static unsigned char prvNotifyUpdate( tskTCB *pxTCB, unsigned long ulValue, eNotifyAction eAction, portBASE_TYPE *pxReturn )
+	{
+	unsigned char ucOriginalNotifyState;
+
+		ucOriginalNotifyState = pxTCB->ucNotifyState;
+		*pxReturn = pdPASS;
+
+		switch( eAction )
+		{
+			case eSetBits	:
+				pxTCB->ulNotifiedValue |= ulValue;
+				break;
+
+			case eIncrement	:
+				( pxTCB->ulNotifiedValue )++;
+				break;
+
+			case eSetValueWithOverwrite	:
+				pxTCB->ulNotifiedValue = ulValue;
+				break;
+
+			case eSetValueWithoutOverwrite :
+				if( ucOriginalNotifyState != taskNOTIFICATION_RECEIVED )
+				{
+					pxTCB->ulNotifiedValue = ulValue;
+				}
+				else
+				{
+					/* The value could not be written to the task. */
+					*pxReturn = pdFAIL;
+				}
+				break;
+
+			case eNoAction :
+			default :
+				/* The task is being notified without its notify value being
+				updated. */
+				break;
+		}
+
+		pxTCB->ucNotifyState = taskNOTIFICATION_RECEIVED;
+
+		return ucOriginalNotifyState;
+	}
+
+#endif
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+
+	portBASE_TYPE xTaskNotify( xTaskHandle xTaskToNotify, unsigned long ulValue, eNotifyAction eAction )
+	{
+	tskTCB *pxTCB;
+	portBASE_TYPE xReturn;
+
+		configASSERT( xTaskToNotify );
+		pxTCB = ( tskTCB * ) xTaskToNotify;
+
+		taskENTER_CRITICAL();
+		{
+			traceTASK_NOTIFY( pxTCB );
+
+			/* If the task was blocked waiting for a notification then move it
+			out of the delayed or suspended list and into its ready list. */
+			if( prvNotifyUpdate( pxTCB, ulValue, eAction, &xReturn ) == taskWAITING_NOTIFICATION )
+			{
+				uxListRemove( &( pxTCB->xGenericListItem ) );
+				prvAddTaskToReadyQueue( pxTCB );
+
+				if( pxTCB->uxPriority > pxCurrentTCB->uxPriority )
+				{
+					/* The notified task has a priority above the currently
+					executing task so a yield is required. */
+					portYIELD_WITHIN_API();
+				}
+			}
+		}
+		taskEXIT_CRITICAL();
+
+		return xReturn;
+	}
+
+#endif
+/*-----------------------------------------------------------*/
+
+#if ( configUSE_TASK_NOTIFICATIONS == 1 )
+
+	portBASE_TYPE xTaskNotifyFromISR( xTaskHandle xTaskToNotify, unsigned long ulValue, eNotifyAction eAction, signed portBASE_TYPE *pxHigherPriorityTaskWoken )
+	{
+	tskTCB *pxTCB;
+	portBASE_TYPE xReturn;
+	unsigned portBASE_TYPE uxSavedInterruptStatus;
+
+		configASSERT( xTaskToNotify );
+		pxTCB = ( tskTCB * ) xTaskToNotify;
+
+		uxSavedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+		{
+			traceTASK_NOTIFY_FROM_ISR( pxTCB );
+
+			if( prvNotifyUpdate( pxTCB, ulValue, eAction, &xReturn ) == taskWAITING_NOTIFICATION )
+			{
+				if( uxSchedulerSuspended == ( unsigned portBASE_TYPE ) pdFALSE )
+				{
+					uxListRemove( &( pxTCB->xGenericListItem ) );
+					prvAddTaskToReadyQueue( pxTCB );
+				}
+				else
+				{
+					/* The delayed and ready lists cannot be accessed, so hold
+					the task pending until the scheduler is resumed.  Its event
+					list item is free because the task is not on an event list. */
+					vListInsertEnd( ( xList * ) &( xPendingReadyList ), &( pxTCB->xEventListItem ) );
+				}
+
+				if( ( pxTCB->uxPriority > pxCurrentTCB->uxPriority ) && ( pxHigherPriorityTaskWoken != NULL ) )
+				{
+					*pxHigherPriorityTaskWoken = pdTRUE;
+				}
+			}
+		}
+		portCLEAR_INTERRUPT_MASK_FROM_ISR( uxSavedInterruptStatus );
+
+		return xReturn;
+	}
+
+#endif
+/*-----------------------------------------------------------*/
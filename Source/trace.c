@@ -0,0 +1,274 @@
+/*******************************************************************************
+* File: trace.c
+*
+* Description: Records kernel events into a ring with microsecond timestamps,
+*  for finding out afterwards why a deadline was missed. Recording runs until
+*  vTraceTrigger is called, and the frozen ring is then read out oldest record
+*  first. Every function may be called from a task or an interrupt.
+*
+*******************************************************************************/
+#include <stddef.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#if configUSE_TRACE_FACILITY != 1
+	#error The trace recorder numbers tasks by uxTCBNumber, which needs configUSE_TRACE_FACILITY.
+#endif
+
+#if configGENERATE_RUN_TIME_STATS != 1
+	#error The trace recorder timestamps with ulPortGetMicroseconds, which needs configGENERATE_RUN_TIME_STATS.
+#endif
+
+/* queue.c provides this without a prototype in queue.h */
+unsigned char ucQueueGetQueueNumber(void *queue);
+
+static xTraceRecord *ring = NULL;
+static uint16_t head = 0;				// where the next record is written
+static uint16_t count = 0;				// records in the ring, oldest at head - count
+static uint16_t lost = 0;				// records overwritten since vTraceStart
+static volatile uint8_t recording = 0;
+static uint8_t triggered = 0;
+static uint8_t clockValid = 0;
+static uint16_t clockHigh;				// bits 31..18 of the clock in the last TRACE_CLOCK
+static uint8_t lastSwitchedIn = 0xFF;	// task number in the last TRACE_SWITCHED_IN
+
+static uint8_t queueCount = 0;
+static const signed char *taskNames[traceMAX_TASKS];
+static const char *queueNames[traceMAX_QUEUES];
+
+static void prvTraceWrite(uint8_t event, uint8_t object, uint16_t time);
+
+/*******************************************************************************
+* Function: vTraceInit
+*
+* Description: Allocates the ring. Nothing is recorded until vTraceStart.
+*  Queues and tasks created before this are still numbered and named.
+*******************************************************************************/
+void vTraceInit(void) {
+	ring = pvPortMalloc(configTRACE_RING_RECORDS * sizeof(xTraceRecord));
+	configASSERT(ring != NULL);
+}
+
+/*******************************************************************************
+* Function: vTraceStart
+*
+* Description: Empties the ring and starts recording.
+*******************************************************************************/
+void vTraceStart(void) {
+	portENTER_CRITICAL();
+	head = 0;
+	count = 0;
+	lost = 0;
+	clockValid = 0;
+	lastSwitchedIn = 0xFF;
+	triggered = 0;
+	recording = (ring != NULL);
+	portEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+* Function: vTraceTrigger
+*
+* Description: Records a TRACE_TRIGGER event and stops recording, keeping the
+*  events that led up to it. Does nothing unless recording.
+*******************************************************************************/
+void vTraceTrigger(void) {
+	portENTER_CRITICAL();
+	if (recording) {
+		vTraceRecord(TRACE_TRIGGER, 0);
+		recording = 0;
+		triggered = 1;
+	}
+	portEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+* Function: uTraceTriggered
+*
+* return: Non-zero once vTraceTrigger has stopped recording, until vTraceStart
+*******************************************************************************/
+uint8_t uTraceTriggered(void) {
+	return triggered;
+}
+
+/*******************************************************************************
+* Function: vTraceMark
+*
+* Description: Records a TRACE_MARK event, so the host can line the kernel's
+*  events up with the application's, such as the start of each frame.
+*
+* param id: Which mark this is, as far as the caller is concerned
+*******************************************************************************/
+void vTraceMark(uint8_t id) {
+	vTraceRecord(TRACE_MARK, id);
+}
+
+/*******************************************************************************
+* Function: uTraceRead
+*
+* Description: Takes the oldest records out of the ring. Only to be called
+*  while recording is stopped.
+*
+* param records: Where to copy the records
+* param max: The most records to copy
+* return: The number of records copied, 0 once the ring is empty
+*******************************************************************************/
+uint16_t uTraceRead(xTraceRecord *records, uint16_t max) {
+	uint16_t i, tail;
+
+	if (recording)
+	    return 0;
+	if (max > count)
+	    max = count;
+
+	tail = (head + configTRACE_RING_RECORDS - count) % configTRACE_RING_RECORDS;
+	for (i = 0; i < max; i++) {
+		records[i] = ring[tail];
+		if (++tail == configTRACE_RING_RECORDS)
+		    tail = 0;
+	}
+	count -= max;
+	return max;
+}
+
+/*******************************************************************************
+* Function: uTraceLost
+*
+* return: The number of records overwritten since vTraceStart, at most 0xFFFF
+*******************************************************************************/
+uint16_t uTraceLost(void) {
+	return lost;
+}
+
+/*******************************************************************************
+* Function: vTraceNameQueue
+*
+* Description: Gives a queue, semaphore or mutex a name for the host.
+*
+* param queue: The queue's handle
+* param name: The name, which must outlive the queue
+*******************************************************************************/
+void vTraceNameQueue(void *queue, const char *name) {
+	uint8_t number = ucQueueGetQueueNumber(queue);
+
+	if (number > 0 && number <= traceMAX_QUEUES)
+	    queueNames[number - 1] = name;
+}
+
+/*******************************************************************************
+* Function: pcTraceTaskName
+*
+* param number: A task number from a record
+* return: The task's name, or NULL if the number is not known
+*******************************************************************************/
+const char *pcTraceTaskName(uint8_t number) {
+	if (number < traceMAX_TASKS)
+	    return (const char *)taskNames[number];
+	return NULL;
+}
+
+/*******************************************************************************
+* Function: pcTraceQueueName
+*
+* param number: A queue number from a record
+* return: The name given by vTraceNameQueue, or NULL
+*******************************************************************************/
+const char *pcTraceQueueName(uint8_t number) {
+	if (number > 0 && number <= traceMAX_QUEUES)
+	    return queueNames[number - 1];
+	return NULL;
+}
+
+/*******************************************************************************
+* Function: vTraceRecord
+*
+* Description: Adds an event to the ring, overwriting the oldest record if it
+*  is full. Called by the kernel's trace macros, often from an interrupt or a
+*  critical section.
+*
+* param event: One of the TRACE_ events
+* param object: The task, queue or mark the event concerns
+*******************************************************************************/
+void vTraceRecord(uint8_t event, uint8_t object) {
+	uint32_t now;
+
+	// tested inside the critical section, so a task preempted by
+	// vTraceTrigger can not write while the ring is being read
+	portENTER_CRITICAL();
+	if (recording) {
+		now = ulPortGetMicroseconds();
+		if (!clockValid || (uint16_t)(now >> 18) != clockHigh) {
+			clockHigh = now >> 18;
+			clockValid = 1;
+			prvTraceWrite(TRACE_CLOCK, 0, clockHigh);
+		}
+		prvTraceWrite(event, object, (uint16_t)(now >> 2));
+	}
+	portEXIT_CRITICAL();
+}
+
+/*******************************************************************************
+* Function: vTraceSwitchedIn
+*
+* Description: Records a task switch. The tick interrupt calls the scheduler
+*  every tick, so most calls switch back in the task that was already running;
+*  those are left out.
+*
+* param number: The uxTCBNumber of the task switched in
+*******************************************************************************/
+void vTraceSwitchedIn(uint8_t number) {
+	if (number != lastSwitchedIn) {
+		lastSwitchedIn = number;
+		vTraceRecord(TRACE_SWITCHED_IN, number);
+	}
+}
+
+/*******************************************************************************
+* Function: vTraceTaskCreated
+*
+* Description: Keeps the name of a new task for the host and records its
+*  creation.
+*
+* param number: The task's uxTCBNumber
+* param name: The name in the task's TCB
+*******************************************************************************/
+void vTraceTaskCreated(uint8_t number, const signed char *name) {
+	if (number < traceMAX_TASKS)
+	    taskNames[number] = name;
+	vTraceRecord(TRACE_TASK_CREATE, number);
+}
+
+/*******************************************************************************
+* Function: uTraceQueueCreated
+*
+* Description: Numbers a new queue, semaphore or mutex. Called by the kernel
+*  inside a critical section.
+*
+* return: The queue's number, from 1
+*******************************************************************************/
+uint8_t uTraceQueueCreated(void) {
+	return ++queueCount;
+}
+
+/*******************************************************************************
+* Function: prvTraceWrite
+*
+* Description: Writes one record at the head of the ring. The caller holds a
+*  critical section.
+*******************************************************************************/
+static void prvTraceWrite(uint8_t event, uint8_t object, uint16_t time) {
+	xTraceRecord *record = &ring[head];
+
+	record->event = event;
+	record->object = object;
+	record->time = time;
+
+	if (++head == configTRACE_RING_RECORDS)
+	    head = 0;
+	if (count < configTRACE_RING_RECORDS) {
+		count++;
+	} else if (lost < 0xFFFF) {
+		lost++;
+	}
+}
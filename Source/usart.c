@@ -11,46 +11,177 @@
 ***************************/
 
 #include "FreeRTOS.h"
+#include "task.h"
 #include "semphr.h"
 
 #include <stdlib.h>
 #include <stdint.h>
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
 
 
 #include "usart.h"
 
+/* Size of the transmit ring. Must be a power of two no larger than 256. */
+#define USART_TX_BUFFER_SIZE    128
+#define USART_TX_BUFFER_MASK    (USART_TX_BUFFER_SIZE - 1)
+
+/* The ring has a single producer (the task holding the graphics link) which
+ * only writes txHead, and a single consumer (the UDRE interrupt) which only
+ * writes txTail, so neither side needs a lock to move its own index. */
+static volatile uint8_t txBuffer[USART_TX_BUFFER_SIZE];
+static volatile uint8_t txHead = 0;
+static volatile uint8_t txTail = 0;
+
+/* The task blocked in USART_WriteBlock on a full ring, if any. The UDRE
+ * interrupt notifies it once half the ring is free again. */
+static xTaskHandle txWaiter = NULL;
+
+static volatile xUsartReceiveHandler rxHandler = NULL;
+
+static uint16_t prvBaudSetting(uint32_t baud, uint32_t clk_speed,
+ uint16_t *ubrr, uint8_t *doubleSpeed);
+
 /************************************
 * Procedure: usart_init
-*  
-* Description: Initializes the USART module with 
-*  the specified baud rate and clk speed.
+*
+* Description: Initializes the USART module with
+*  the specified baud rate and clk speed,
+*  using whichever of normal and double
+*  speed mode comes closest to the rate.
 *
 * Param buadin: The desired Baud rate.
 * Param clk_seedin: The clk speed of the ATmega328p
 ************************************/
-void USART_Init(uint16_t baudin, uint32_t clk_speedin) {
-    uint32_t ubrr = clk_speedin/(16UL)/baudin-1;
+void USART_Init(uint32_t baudin, uint32_t clk_speedin) {
+    uint16_t ubrr;
+    uint8_t doubleSpeed;
+
+    prvBaudSetting(baudin, clk_speedin, &ubrr, &doubleSpeed);
+
     UBRR0H = (unsigned char)(ubrr>>8) ;// & 0x7F;
     UBRR0L = (unsigned char)ubrr;
     /* Enable receiver and transmitter */
     UCSR0B = (1<<RXEN0)|(1<<TXEN0);
     /* Set frame format: 8data, 1stop bit */
     UCSR0C = (1<<UCSZ01)|(1<<UCSZ00);
-	// clear U2X0 for Synchronous operation
-    UCSR0A &= ~(1<<U2X0);
+    if (doubleSpeed) {
+        UCSR0A |= (1<<U2X0);
+    } else {
+        UCSR0A &= ~(1<<U2X0);
+    }
+
+    txHead = 0;
+    txTail = 0;
 }
 
-/*the send function will put 8bits on the trans line. */
+/************************************
+* Procedure: USART_BaudError
+*
+* Description: The error of the closest rate
+*  USART_Init can set to the one asked for.
+*
+* Param baud: The desired Baud rate.
+* Param clk_speed: The clk speed of the chip
+* Return: The error in tenths of a percent
+************************************/
+uint16_t USART_BaudError(uint32_t baud, uint32_t clk_speed) {
+	uint16_t ubrr;
+	uint8_t doubleSpeed;
+
+	return prvBaudSetting(baud, clk_speed, &ubrr, &doubleSpeed);
+}
+
+/* Picks the UBRR value and U2X0 setting closest to the baud rate, preferring
+normal speed on a tie since it samples each bit more often. Returns the error
+in tenths of a percent. */
+static uint16_t prvBaudSetting(uint32_t baud, uint32_t clk_speed,
+ uint16_t *ubrr, uint8_t *doubleSpeed) {
+	uint32_t divisor, value, actual, error;
+	uint16_t bestError = 0xFFFF;
+	uint8_t u2x;
+
+	for (u2x = 0; u2x < 2; u2x++) {
+		divisor = (u2x ? 8UL : 16UL) * baud;
+		/* rounded, then clamped to the 12 bits of UBRR0 */
+		value = (clk_speed + divisor / 2) / divisor;
+		value = value == 0 ? 0 : value - 1;
+		if (value > 0x0FFF) {
+			value = 0x0FFF;
+		}
+
+		actual = clk_speed / ((u2x ? 8UL : 16UL) * (value + 1));
+		error = (actual > baud ? actual - baud : baud - actual) * 1000UL / baud;
+		if (error > 0xFFFE) {
+			error = 0xFFFE;
+		}
+		if (error < bestError) {
+			bestError = error;
+			*ubrr = value;
+			*doubleSpeed = u2x;
+		}
+	}
+
+	return bestError;
+}
+
+/************************************
+* Procedure: USART_Write
+*
+* Description: Queues a single byte for
+*  transmission. See USART_WriteBlock.
+*
+* Param data: 8bit data value
+************************************/
 void USART_Write(uint8_t data) {
-		/* Wait for empty transmit buffer */
-		while ( !( UCSR0A & (1<<UDRE0)) )
-		;
-		/* Put data into buffer, sends the data */
-		UDR0 = nextByte;
+	USART_WriteBlock(&data, 1);
 }
 
-/*the send function will put 8bits on the trans line. */
+/************************************
+* Procedure: USART_WriteBlock
+*
+* Description: Copies a block of bytes into
+*  the transmit ring and lets the UDRE
+*  interrupt send them. Only blocks while
+*  the ring is full, waiting on the task's
+*  notification until the interrupt has
+*  drained half of it. Must be called from
+*  a task, and only by one task at a time.
+*
+* Param data: The bytes to send
+* Param length: The number of bytes to send
+************************************/
+void USART_WriteBlock(const uint8_t *data, uint16_t length) {
+	uint8_t head = txHead;
+	uint8_t next;
+
+	while (length > 0) {
+		next = (head + 1) & USART_TX_BUFFER_MASK;
+		if (next == txTail) {
+			/* Ring is full; publish what we have and wait for it to drain.
+			A notification meant for something else only causes a recheck. */
+			txHead = head;
+			portENTER_CRITICAL();
+			txWaiter = xTaskGetCurrentTaskHandle();
+			UCSR0B |= (1<<UDRIE0);
+			portEXIT_CRITICAL();
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			continue;
+		}
+		txBuffer[head] = *data++;
+		head = next;
+		length--;
+	}
+
+	txHead = head;
+	portENTER_CRITICAL();
+	UCSR0B |= (1<<UDRIE0);
+	portEXIT_CRITICAL();
+}
+
+/*the send function will put 8bits on the trans line. Bypasses the
+transmit ring, so it may only be used before the scheduler is started. */
 void USART_Write_Unprotected(uint8_t data) {
 	/* Wait for empty transmit buffer */
 	while ( !( UCSR0A & (1<<UDRE0)) )
@@ -60,8 +191,8 @@ void USART_Write_Unprotected(uint8_t data) {
 }
 
 /* the receive data function. Note that this a blocking call
-Therefore you may not get control back after this is called 
-until a much later time. It may be helpful to use the 
+Therefore you may not get control back after this is called
+until a much later time. It may be helpful to use the
 istheredata() function to check before calling this function
         @return 8bit data packet from sender
 */
@@ -72,3 +203,95 @@ uint8_t USART_Read(void) {
     /* Get and return received data from buffer */
     return UDR0;
 }
+
+/************************************
+* Procedure: USART_ReadTimeout
+*
+* Description: Polled read which gives up
+*  after a while. Like USART_Read, it may
+*  only be used before a receive handler
+*  is installed.
+*
+* Param ms: The longest time to wait
+* Return: The received byte, or -1 if none
+*  arrived in time
+************************************/
+int16_t USART_ReadTimeout(uint16_t ms) {
+	uint32_t polls = (uint32_t)ms * 10;
+
+	while ( !(UCSR0A & (1<<RXC0)) ) {
+		if (polls == 0) {
+			return -1;
+		}
+		polls--;
+		_delay_us(100);
+	}
+	return UDR0;
+}
+
+/************************************
+* Procedure: USART_SetReceiveHandler
+*
+* Description: Routes every received byte
+*  to the given handler from the receive
+*  interrupt. USART_Read must not be used
+*  while a handler is installed.
+*
+* Param handler: The handler, or NULL to
+*  go back to polled reads.
+************************************/
+void USART_SetReceiveHandler(xUsartReceiveHandler handler) {
+	portENTER_CRITICAL();
+	rxHandler = handler;
+	if (handler != NULL) {
+		UCSR0B |= (1<<RXCIE0);
+	} else {
+		UCSR0B &= ~(1<<RXCIE0);
+	}
+	portEXIT_CRITICAL();
+}
+
+/* Receive complete interrupt. Hands the byte to the installed handler and
+switches to a woken task if the handler asks for it. */
+#if defined(__AVR_ATmega168__) || defined(__AVR_ATmega328P__)
+ISR( USART_RX_vect )
+#else
+ISR( USART0_RX_vect )
+#endif
+{
+	uint8_t data = UDR0;
+
+	if (rxHandler != NULL && rxHandler(data) != pdFALSE) {
+		taskYIELD();
+	}
+}
+
+/* Data register empty interrupt. Feeds the next byte of the transmit ring to
+the USART, wakes a writer waiting for room once half the ring is free, and
+switches itself off once the ring is empty. */
+#if defined(__AVR_ATmega168__) || defined(__AVR_ATmega328P__)
+ISR( USART_UDRE_vect )
+#else
+ISR( USART0_UDRE_vect )
+#endif
+{
+	uint8_t tail = txTail;
+	portBASE_TYPE woken = pdFALSE;
+
+	if (tail != txHead) {
+		UDR0 = txBuffer[tail];
+		tail = (tail + 1) & USART_TX_BUFFER_MASK;
+		txTail = tail;
+	} else {
+		UCSR0B &= ~(1<<UDRIE0);
+	}
+
+	if (txWaiter != NULL
+	 && ((txHead - tail) & USART_TX_BUFFER_MASK) <= USART_TX_BUFFER_SIZE / 2) {
+		vTaskNotifyGiveFromISR(txWaiter, &woken);
+		txWaiter = NULL;
+		if (woken != pdFALSE) {
+			taskYIELD();
+		}
+	}
+}
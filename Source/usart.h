@@ -13,9 +13,17 @@
 #ifndef USART_H_
 #define USART_H_
 
+/* Called from the receive interrupt with each received byte. Returns pdTRUE
+ * if it woke a task which should run before the interrupted one. */
+typedef portBASE_TYPE (*xUsartReceiveHandler)(uint8_t data);
+
 uint8_t USART_Read(void);
+int16_t USART_ReadTimeout(uint16_t ms);
 void USART_Write(uint8_t data);
+void USART_WriteBlock(const uint8_t *data, uint16_t length);
 void USART_Write_Unprotected(uint8_t data);
-void USART_Init(uint16_t baudin, uint32_t clk_speedin);
+void USART_Init(uint32_t baudin, uint32_t clk_speedin);
+uint16_t USART_BaudError(uint32_t baud, uint32_t clk_speed);
+void USART_SetReceiveHandler(xUsartReceiveHandler handler);
 
 #endif /* USART_H_ */